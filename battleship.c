@@ -12,593 +12,5152 @@
  * This version of Battleship is played on the console, and the players communicate through the
  * an Altera FPGA board. The board uses a custom designed SRAM module to store the states of
  * each players' board as the game progresses.
+ *
+ * The SRAM and the data link are reached through a small hardware abstraction
+ * layer with two backends. The default backend drives the memory-mapped
+ * registers on the board. Building with -DHOST_SIM selects the host backend,
+ * where the SRAM is an array and the data link is a TCP socket, so the same
+ * game runs on a PC:
+ *
+ *     cc -DHOST_SIM -o battleship battleship.c
+ *     ./battleship --listen 5000          (first player)
+ *     ./battleship --connect host:5000    (second player)
+ *
+ * On a noisy link both players can add --fec (or build with
+ * -DLINK_CODE=LINK_SECDED) to send every character with an
+ * error-correcting code instead of a parity bit.
+ *
+ * Adding --log file appends each game to a compact event log (the board
+ * keeps the same log in spare SRAM), and --replay prints the boards of
+ * the logged game as they stood after a given number of shots:
+ *
+ *     ./battleship --replay game.log 20
+ *
+ * For unattended games, --script file (or typing "script" at the first
+ * placement prompt and then the plan) plays a whole game from a plan:
+ * the player, each ship from the largest down as a coordinate and an
+ * orientation, then the shots in order, separated by blanks and ended
+ * by "end" or the end of the file:
+ *
+ *     1  A1h C3v  B2 B3 B4 C6 end
+ *
+ * A board that is reset in the middle of a game picks it up again from
+ * the SRAM; on the host, --sram file keeps the emulated SRAM in a file
+ * so a restarted player resumes the same way.
+ *
+ * Adding -DANALYSIS (with -pthread) builds a batch tool instead that plays
+ * CPU-vs-CPU games on every core and reports how each strategy fares:
+ *
+ *     cc -DHOST_SIM -DANALYSIS -O2 -pthread -o analysis battleship.c
+ *     ./analysis --games 1000000 --threads 8
+ *
+ * Adding -DSERVER builds a game server that plays the CPU player against
+ * every client connecting to it (clients play as player 1), and that can
+ * relay a board's link from a serial line to the server:
+ *
+ *     cc -DHOST_SIM -DSERVER -o server battleship.c
+ *     ./server --serve 5000
+ *     ./server --bridge /dev/ttyUSB0 host:5000
+ *
+ * Building with -DSMALL_FOOTPRINT makes the game fit the boards with the
+ * least on-chip memory, at the cost of board sizes above 16 x 16 and the
+ * banner and rules on the splash screen.
  */
 
+#ifdef HOST_SIM
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#ifdef ANALYSIS
+#include <pthread.h>
+#endif
+#ifdef SERVER
+#include <termios.h>
+#include <sys/epoll.h>
+#endif
+#else
+#include "system.h"
 #include "sys/alt_stdio.h"
+#include "sys/alt_irq.h"
 #include "altera_avalon_pio_regs.h"
+#include "altera_avalon_jtag_uart_regs.h"
+#if defined(BENCHMARK) || defined(INSTRUMENT)
+#include "sys/alt_timestamp.h"
+#endif
+#endif
+#include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <stdarg.h>
+
+#ifdef HOST_SIM
+// Host Simulation (the SRAM is emulated in memory and the data link is a
+// socket carrying the same parity-tagged bytes as the hardware link)
+#define SRAM_SIZE 2048
+#define HOST_WAIT_MS 10
+#else
+// SRAM (Processor Inputs and Outputs; volatile, so the compiler keeps every
+// access to the PIOs, in program order)
+#define data (volatile char*) 0x21000
+#define address (volatile char*) 0x21010
+#define chipSelect (volatile char*) 0x21020
+#define readnWrite (volatile char*) 0x21030
+#define notOutEn (volatile char*) 0x21040
+
+// Communications System (Processor Inputs and Outputs; volatile like the SRAM
+// ones, so the load strobe is pulsed and char_sent polled as written)
+#define char_read (volatile char*) 0x21050
+#define char_recv (volatile char*) 0x21060
+#define data_in (volatile char*) 0x21070
+#define load (volatile char*) 0x21080
+#define char_sent (volatile char*) 0x21090
+#define trans_en (volatile char*) 0x210a0
+#define data_out (volatile char*) 0x210b0
+#define LEDs (volatile char*) 0x210c0
+#endif
+
+// Small Footprint (a SMALL_FOOTPRINT build caps the board at 16 x 16, which
+// shrinks the board cache, the CPU player's maps, the constant tables and the
+// copies of a board on the stack with it, shortens the console, transmit and
+// key queues, and leaves the banner and the rules out of the splash screen)
+#ifdef SMALL_FOOTPRINT
+#ifndef CON_BUFFER_SIZE
+#define CON_BUFFER_SIZE 256
+#endif
+#define TX_RING_SIZE 32
+#define KEY_RING_SIZE 16
+#endif
 
-// SRAM (Processor Inputs and Outputs)
-#define data (char*) 0x21000
-#define address (char*) 0x21010
-#define chipSelect (char*) 0x21020
-#define readnWrite (char*) 0x21030
-#define notOutEn (char*) 0x21040
-
-// Communications System (Processor Inputs and Outputs)
-#define char_read (char*) 0x21050
-#define char_recv (char*) 0x21060
-#define data_in (char*) 0x21070
-#define load (char*) 0x21080
-#define char_sent (char*) 0x21090
-#define trans_en (char*) 0x210a0
-#define data_out (char*) 0x210b0
-#define LEDs (char*) 0x210c0
+// Log Levels (traces above LOG_LEVEL compile to nothing; build with
+// -DLOG_LEVEL=LOG_LEVEL_DEBUG to get the diagnostic prints back)
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_ERROR
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) conPrintf(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) conPrintf(__VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) conPrintf(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+// Link Handshake (fixed delays are kept as a fallback for slow peers)
+#define HANDSHAKE_FIXED 0
+#define HANDSHAKE_ADAPTIVE 1
+#ifndef LINK_HANDSHAKE
+#define LINK_HANDSHAKE HANDSHAKE_ADAPTIVE
+#endif
+#define LINK_SETTLE_US 5
+#define LINK_GAP_US 100
+#define LINK_POLL_LIMIT 2000
+#define LINK_FREE 0
+#define LINK_SENDING 1
+#define LINK_RELEASING 2
+
+// Link Transmit Queue (sendString() queues the coded bytes of a whole message
+// and returns; the queue drains whenever the program polls the link, handing
+// the backend up to LINK_TX_WINDOW bytes per call, so the host sends a message
+// with one system call and the board starts each byte as soon as the last one
+// is latched. The queue counters run freely, so TX_RING_SIZE is a power of two)
+#ifndef TX_RING_SIZE
+#define TX_RING_SIZE 128
+#endif
+#ifndef LINK_TX_WINDOW
+#define LINK_TX_WINDOW 32
+#endif
+
+// Link Receive Ring (filled by the char_recv interrupt, or by polling if the
+// PIO has no IRQ line in this system; polling stops while the ring is full. A
+// replay burst, NAK and SYN plus FRAME_HISTORY frames of bufLen characters with
+// their markers, takes 32 entries, so the ring holds two. A byte the interrupt
+// finds no room for is lost, and the next one is flagged with RX_PARITY_ERROR
+// so the frame it belonged to is NAKed)
+#define RX_RING_SIZE 64
+#define RX_PARITY_ERROR 0x100
+#define LINK_IDLE_US 50
+
+// Link Framing (frames are NUL-terminated and at most bufLen bytes long; a
+// receiver that drops a frame answers with NAK and skips ahead to the SYN that
+// starts the sender's replay)
+#define FRAME_OK 0
+#define FRAME_PARITY 1
+#define FRAME_OVERFLOW 2
+#define FRAME_PENDING 3
+#define FRAME_TIMEOUT 4
+#define FRAME_NAK 0x15
+#define FRAME_SYN 0x16
+#define FRAME_HISTORY 2
+
+// Link Coding (parity mode sends each character as 7 bits and a parity bit,
+// so any flipped bit costs the whole frame; SECDED mode sends a character as
+// two extended Hamming(8,4) bytes, one per nibble, which corrects a flipped bit
+// in place and detects two. SECDED mode numbers every data frame with a
+// FRAME_SEQ marker and parity mode only the frames of a replay, keeping the
+// common message to its payload; either way frames repeated by a replay are
+// dropped, and a NAK is repeated every LINK_RETRY_US until the replay
+// arrives. The loser of a game keeps answering NAKs until the link has been
+// quiet for LINK_RETRY_LIMIT of those intervals)
+#define LINK_PARITY 0
+#define LINK_SECDED 1
+#ifndef LINK_CODE
+#define LINK_CODE LINK_PARITY
+#endif
+#define RX_PENDING 0x200
+#define RX_TIMEOUT 0x400
+#define FRAME_SEQ 0x18
+#define FRAME_SEQUENCES 8
+#define LINK_RETRY_US 200000
+#define LINK_RETRY_LIMIT 5
+#ifdef HOST_SIM
+#define LINK_RETRY_IDLES (LINK_RETRY_US / (HOST_WAIT_MS * 1000))
+#else
+#define LINK_RETRY_IDLES (LINK_RETRY_US / LINK_IDLE_US)
+#endif
+
+// Turn Messages (each message is a result for the other player's previous
+// shot followed by your next shot, e.g. "1C4"; the opening shot carries
+// RESULT_NONE and the shot that ends the game is answered by a bare result.
+// A hit that sinks a ship is answered with the ship's length instead, e.g.
+// "3C4" for a length 3 ship)
+#define RESULT_NONE '-'
+#define RESULT_MISS '0'
+#define RESULT_HIT '1'
+#define RESULT_SUNK(length) ('0' + (length))
+
+// Wire Modes (ASCII sends turn messages as text for debugging; binary packs
+// the result bit and a 3+3 bit coordinate into one 7-bit payload, with
+// WIRE_ESCAPE introducing control frames and a literal 0x7F payload. A hit
+// that sinks a ship is preceded by WIRE_ESCAPE and FRAME_SUNK plus the ship's
+// length, so the common message stays one frame)
+#define WIRE_ASCII 0
+#define WIRE_BINARY 1
+#ifndef WIRE_MODE
+#define WIRE_MODE WIRE_BINARY
+#endif
+#define WIRE_ESCAPE 0x7F
+#define FRAME_SUNK 0x08
+
+// Rendering (ANSI mode draws both boards once at the top of the screen, keeps
+// the prompts in a scroll region below them and then redraws only the cells
+// that changed; full mode reprints both boards every time)
+#define RENDER_FULL 0
+#define RENDER_ANSI 1
+#ifndef RENDER_MODE
+#define RENDER_MODE RENDER_ANSI
+#endif
+#define ENEMY_ROW_LINE 3
+#define FLEET_ROW_LINE (ENEMY_ROW_LINE + boardHeight + 3)
+#define SCROLL_TOP_LINE (FLEET_ROW_LINE + boardHeight + 1)
+
+// Console Buffer (console output is collected in RAM and written to the JTAG
+// UART by the render task CON_CHUNK bytes at a time while the game waits, or
+// in one call when the buffer fills or the program ends. A chunk fills the
+// UART's 64-byte FIFO; the host's stdout takes the whole buffer at once)
+#ifndef CON_BUFFER_SIZE
+#define CON_BUFFER_SIZE 1024
+#endif
+#ifndef CON_CHUNK
+#ifdef HOST_SIM
+#define CON_CHUNK CON_BUFFER_SIZE
+#else
+#define CON_CHUNK 64
+#endif
+#endif
+
+// Cooperative Tasks (stackless protothreads: a task runs until it has to wait,
+// records the line it stopped at in its task state and returns, so all tasks
+// share the one stack. Every wait of the game flow, for a key or a frame, gives
+// each task a turn: the keyboard task queues keystrokes, the link task moves
+// bytes on and off the data link, the SRAM task writes the boards back a run
+// of rows at a time and the render task drains the console buffer, so input,
+// link and output overlap. Locals do not survive a TASK_WAIT_UNTIL or a
+// TASK_YIELD; the key queue counters run freely, so KEY_RING_SIZE is a power
+// of two)
+#define TASK_WAITING 0
+#define TASK_RAN 1
+#define TASK_BEGIN(task) switch ((task)->line) { case 0:
+#define TASK_WAIT_UNTIL(task, condition) do { (task)->line = __LINE__; case __LINE__: \
+		if (!(condition)) return TASK_WAITING; } while (0)
+#define TASK_YIELD(task) do { (task)->line = __LINE__; return TASK_RAN; case __LINE__:; } while (0)
+#define TASK_END(task) } (task)->line = 0; return TASK_RAN
+#ifndef KEY_RING_SIZE
+#define KEY_RING_SIZE 64
+#endif
+
+// Instrumentation (an INSTRUMENT build counts calls, bytes and timer cycles
+// spent in the SRAM and link primitives, plus parity errors; without the flag
+// the probes compile to nothing)
+#define PROBE_SRAM_READ 0
+#define PROBE_SRAM_WRITE 1
+#define PROBE_SEND 2
+#define PROBE_RECV 3
+#define PROBE_COUNT 4
+#ifdef INSTRUMENT
+#define PROBE_START(t) unsigned long long t = benchNow()
+#define PROBE_STOP(id, t, n) (probes[id].calls++, probes[id].bytes += (n), \
+		probes[id].cycles += benchNow() - (t))
+#define PROBE_BYTES(id, n) (probes[id].bytes += (n))
+#define PROBE_PARITY_ERROR() (parityErrors++)
+#define PROBE_CORRECTED() (correctedBits++)
+#else
+#define PROBE_START(t) do {} while (0)
+#define PROBE_STOP(id, t, n) do {} while (0)
+#define PROBE_BYTES(id, n) do {} while (0)
+#define PROBE_PARITY_ERROR() do {} while (0)
+#define PROBE_CORRECTED() do {} while (0)
+#endif
 
 // Global Constants
 #define bufLen 10
 #define SMALL_SHIP_LENGTH 3
 #define LARGE_SHIP_LENGTH 4
+#ifndef BOARD_WIDTH
 #define BOARD_WIDTH (unsigned int) 8
+#endif
+#ifndef BOARD_HEIGHT
 #define BOARD_HEIGHT (unsigned int) 8
+#endif
+#ifdef SMALL_FOOTPRINT
+#define MAX_BOARD_WIDTH 16
+#define MAX_BOARD_HEIGHT 16
+#else
+#define MAX_BOARD_WIDTH 64
+#define MAX_BOARD_HEIGHT 64
+#endif
+#define MAX_BOARD_ROWS (3 * MAX_BOARD_HEIGHT)
+#define SYNC_CHUNK_ROWS 8
+#define ROW_WORD_BITS 64
+
+// Board Layout (each board row is one 64-bit word with column 1 in the most
+// significant used bit, so a row of any width up to 64 is tested and updated
+// with a single shift and mask; the three boards are stored one after the
+// other, and in SRAM each row takes rowBytes bytes, most significant first)
 #define shotsBase (unsigned int) 0
-#define hitsBase (unsigned int) 8
-#define boardBase (unsigned int) 16
+#define hitsBase boardHeight
+#define boardBase (2 * boardHeight)
+#define boardRows (3 * boardHeight)
+#define TOTAL_HITS ((SMALL_SHIP_LENGTH + LARGE_SHIP_LENGTH) * (LARGE_SHIP_LENGTH - SMALL_SHIP_LENGTH + 1) / 2)
+#define SHIP_COUNT (LARGE_SHIP_LENGTH - SMALL_SHIP_LENGTH + 1)
+
+// Event Log (an append-only record of each game, LOG_EVENT_SIZE bytes per
+// event: the type in the top three bits of the first byte, flags in the
+// low five, then two operands, e.g. the zero-based column and row of a shot.
+// Events are collected in the game context and written out with the boards
+// once per turn, to the SRAM past the largest boards and, on the host, also
+// to the --log file; an all-zero event ends the log in SRAM)
+#define EVENT_END 0
+#define EVENT_GAME 1
+#define EVENT_PLACE 2
+#define EVENT_SHOT 3
+#define EVENT_INCOMING 4
+#define EVENT_OVER 5
+#define EVENT_HIT 0x01
+#define EVENT_WON 0x01
+#define EVENT_VERTICAL 0x10
+#define LOG_EVENT_SIZE 3
+#define LOG_PENDING (SHIP_COUNT + 4)
+#define LOG_BASE (MAX_BOARD_ROWS * MAX_BOARD_WIDTH / 8)
+#define LOG_LIMIT RESUME_BASE
+
+// Script Plan (a whole game read in one pass before it starts: the player,
+// a coordinate and an orientation for each ship, and up to PLAN_SHOTS shots,
+// enough to cover a 16 x 16 board; tokens longer than PLAN_TOKEN - 1
+// characters never parse. The plan is checked as a whole against scratch
+// bitboards, then the game runs from it without prompts, and if the shots
+// run out before the game is over the CPU player fires the rest)
+#define PLAN_SHOTS 256
+#define PLAN_TOKEN 8
+
+// Resume State (what a game needs besides its boards to carry on after the
+// board is reset: player, turn, hit counts, the shot awaiting a result, the
+// last frame sent, the fleet and the enemy ships sunk so far (behind their
+// count), kept in RESUME_SIZE bytes at the top of the
+// SRAM and rewritten with the boards every turn. Its Fletcher-16 checksum
+// covers the boards too, so a reset between the two writes is not resumed)
+#define RESUME_MAGIC 0xB5
+#define RESUME_FRAME 17
+#define RESUME_SHIPS (RESUME_FRAME + bufLen)
+#define RESUME_SUNK (RESUME_SHIPS + 4 * SHIP_COUNT)
+#define RESUME_SIZE (RESUME_SUNK + 1 + 4 * SHIP_COUNT + 2)
+#define RESUME_BASE (2048 - RESUME_SIZE)
+
+// Benchmark (a BENCHMARK build plays whole games with random moves and keeps a
+// latency histogram per phase; bucket k counts calls shorter than 2^(k+1)
+// timer ticks, which are nanoseconds on the host)
+#define PHASE_SRAM 0
+#define PHASE_SEND 1
+#define PHASE_RECV 2
+#define PHASE_RENDER 3
+#define PHASE_COUNT 4
+#define BENCH_BUCKETS 40
+#ifndef BENCH_GAMES
+#define BENCH_GAMES 100
+#endif
+#ifdef HOST_SIM
+#define BENCH_UNIT "ns"
+#else
+#define BENCH_UNIT "ticks"
+#endif
+#if defined(ANALYSIS) && !defined(HOST_SIM)
+#error "ANALYSIS builds run on the host simulation only"
+#endif
+#if defined(SERVER) && !defined(HOST_SIM)
+#error "SERVER builds run on the host simulation only"
+#endif
+
+// Server (each session buffers what it sends until the socket takes it. One
+// frame from the client makes it send at most SESSION_BURST bytes, a SYN-led
+// replay of FRAME_HISTORY frames with their markers at two bytes a character in
+// SECDED mode; while less than that is free the client's input is left in its
+// socket, and no NAK is repeated, until the buffer drains)
+#define SESSION_BURST (2 * (2 + FRAME_HISTORY * (4 + bufLen)))
+#define SESSION_TX_SIZE (2 * SESSION_BURST)
+#define SERVER_EVENTS 64
+
+// Analysis (an ANALYSIS build plays --games games for every ordered pair of
+// strategies, split into batches that idle worker threads steal from the
+// others' queues)
+#define STRATEGY_RANDOM 0
+#define STRATEGY_DENSITY 1
+#define STRATEGY_TARGET 2
+#define STRATEGY_COUNT 3
+#ifndef ANALYSIS_GAMES
+#define ANALYSIS_GAMES 100000
+#endif
+#define ANALYSIS_BATCH 1024
+
+#ifdef BENCHMARK
+#define BENCH_START(t) unsigned long long t = benchNow()
+#define BENCH_STOP(phase, t) benchRecord(phase, benchNow() - (t))
+#else
+#define BENCH_START(t) do {} while (0)
+#define BENCH_STOP(phase, t) do {} while (0)
+#endif
 
 // Global Variables
-unsigned char inputBuffer[bufLen];
-unsigned char outputBuffer[bufLen];
-unsigned char sent;
-unsigned char parity;
-unsigned int enemyHits;
-unsigned int yourHits = 0;
-unsigned int yourShotX;
-unsigned int yourShotY;
-unsigned int theirShotX;
-unsigned int theirShotY;
+unsigned char renderMode = RENDER_MODE;
+#ifdef HOST_SIM
+unsigned char hostSramMemory[SRAM_SIZE];
+unsigned char *hostSram = hostSramMemory;
+int hostLinkFd = -1;
+unsigned char hostLinkClosed = 0;
+FILE *hostLogFile = 0;
+FILE *hostScriptFile = 0;
+#endif
+unsigned char autoPlay = 0;
+unsigned char autoPlace = 0;
+#if defined(BENCHMARK) || defined(INSTRUMENT) || defined(ANALYSIS)
+unsigned long long benchNow();
+#endif
+#ifdef INSTRUMENT
+struct probe {
+	unsigned long long calls;
+	unsigned long long bytes;
+	unsigned long long cycles;
+} probes[PROBE_COUNT];
+unsigned long long parityErrors = 0;
+unsigned long long correctedBits = 0;
+#endif
+#ifdef BENCHMARK
+struct phaseStats {
+	unsigned long long count;
+	unsigned long long total;
+	unsigned long long min;
+	unsigned long long max;
+	unsigned long long buckets[BENCH_BUCKETS];
+} benchStats[PHASE_COUNT];
+unsigned int benchGames = BENCH_GAMES;
+void benchRecord(int phase, unsigned long long elapsed);
+#endif
+#ifdef ANALYSIS
+unsigned int analysisGames = ANALYSIS_GAMES;
+unsigned int analysisThreads = 0;
+#endif
+char conBuffer[CON_BUFFER_SIZE];
+unsigned int conLength = 0;
+unsigned int conSent = 0;
+unsigned char conMuted = 0;
+unsigned char keyRing[KEY_RING_SIZE];
+unsigned int keyHead = 0;
+unsigned int keyTail = 0;
+unsigned char keyEnded = 0;
+struct gameContext *syncGame = 0;
+unsigned int syncRow = 0;
+int runTasks();
+int readPlan(int (*nextChar)(void));
+void linkIdle();
+unsigned char frameDrawn = 0;
+unsigned char linkHandshake = LINK_HANDSHAKE;
+unsigned char linkState = LINK_FREE;
+unsigned int linkPolls = 0;
+unsigned char txRing[TX_RING_SIZE];
+unsigned int txHead = 0;
+unsigned int txTail = 0;
+void pumpLink();
+volatile unsigned short rxRing[RX_RING_SIZE];
+volatile unsigned int rxHead = 0;
+volatile unsigned int rxTail = 0;
+volatile unsigned char rxOverrun = 0;
+void (*linkIdleHook)(void) = 0;
+unsigned char wireMode = WIRE_MODE;
+unsigned char linkCode = LINK_CODE;
+
+typedef unsigned long long rowWord;
+unsigned int boardWidth = BOARD_WIDTH;
+unsigned int boardHeight = BOARD_HEIGHT;
+unsigned int rowBytes = 1;
+unsigned int wireFrames = 1;
+unsigned int rowBits = 3;
+unsigned int columnBits = 3;
+rowWord fullRow = 0xFF;
+rowWord drawnShots[MAX_BOARD_HEIGHT];
+rowWord drawnHits[MAX_BOARD_HEIGHT];
+rowWord drawnBoard[MAX_BOARD_HEIGHT];
+
+// Fleet (where a ship was placed, for sunk-ship detection)
+struct ship {
+	unsigned char x;
+	unsigned char y;
+	unsigned char length;
+	unsigned char vertical;
+};
+
+// Task State (where each task stopped, and the function that carries on from there)
+struct task {
+	unsigned int line;
+	int (*run)(struct task *task);
+};
+
+// Script Plan (the plan being played and the next of its shots)
+struct plan {
+	unsigned char player;
+	struct ship ships[SHIP_COUNT];
+	unsigned char shotX[PLAN_SHOTS];
+	unsigned char shotY[PLAN_SHOTS];
+	unsigned int shotCount;
+	unsigned int nextShot;
+};
+struct plan scriptPlan;
+unsigned char scriptPlay = 0;
+
+// Link Decoder (the first byte of a SECDED pair is held until the second
+// arrives; the hardware link has one decoder and each server session another)
+struct linkDecoder {
+	unsigned char half;
+	unsigned char high;
+	unsigned char spoiled;
+};
+struct linkDecoder rxDecoder;
+const unsigned char secdedCodes[16] = {
+	0x00, 0x0F, 0x33, 0x3C, 0x55, 0x5A, 0x66, 0x69,
+	0x96, 0x99, 0xA5, 0xAA, 0xC3, 0xCC, 0xF0, 0xFF
+};
+
+// Placement Masks (for each ship length and orientation, the cells a ship
+// may start at and still fit on the board; placeStarts points at the constant
+// table for the default BOARD_WIDTH x BOARD_HEIGHT, or at a RAM copy built
+// by setBoardSize() for any other size)
+#define PLACE_HORIZONTAL 0
+#define PLACE_VERTICAL 1
+#define REPEAT8(m, a, b, n) m(a, b, (n)), m(a, b, (n) + 1), m(a, b, (n) + 2), m(a, b, (n) + 3), \
+		m(a, b, (n) + 4), m(a, b, (n) + 5), m(a, b, (n) + 6), m(a, b, (n) + 7)
+#define REPEAT64(m, a, b) REPEAT8(m, a, b, 0), REPEAT8(m, a, b, 8), REPEAT8(m, a, b, 16), \
+		REPEAT8(m, a, b, 24), REPEAT8(m, a, b, 32), REPEAT8(m, a, b, 40), \
+		REPEAT8(m, a, b, 48), REPEAT8(m, a, b, 56)
+#define REPEAT16(m, a, b) REPEAT8(m, a, b, 0), REPEAT8(m, a, b, 8)
+#if MAX_BOARD_HEIGHT == 16
+#define REPEAT_ROWS REPEAT16
+#elif MAX_BOARD_HEIGHT == 64
+#define REPEAT_ROWS REPEAT64
+#else
+#error "the constant board tables cover a MAX_BOARD_HEIGHT of 16 or 64"
+#endif
+#define DEFAULT_WIDTH ((int) BOARD_WIDTH)
+#define DEFAULT_HEIGHT ((int) BOARD_HEIGHT)
+#define DEFAULT_FULL_ROW (DEFAULT_WIDTH == ROW_WORD_BITS ? ~(rowWord) 0 : \
+		((rowWord) 1 << (DEFAULT_WIDTH % ROW_WORD_BITS)) - 1)
+#define PLACE_ROW(length, vertical, r) ((r) >= DEFAULT_HEIGHT ? 0 : \
+		(vertical) ? ((r) <= DEFAULT_HEIGHT - (length) ? DEFAULT_FULL_ROW : 0) : \
+		DEFAULT_FULL_ROW & ~(((rowWord) 1 << ((length) - 1)) - 1))
+#define PLACE_TABLE(length) {{REPEAT_ROWS(PLACE_ROW, length, PLACE_HORIZONTAL)}, \
+		{REPEAT_ROWS(PLACE_ROW, length, PLACE_VERTICAL)}}
+const rowWord defaultPlaceStarts[SHIP_COUNT][2][MAX_BOARD_HEIGHT] = {
+	PLACE_TABLE(LARGE_SHIP_LENGTH),
+#if LARGE_SHIP_LENGTH - SMALL_SHIP_LENGTH >= 1
+	PLACE_TABLE(LARGE_SHIP_LENGTH - 1),
+#endif
+#if LARGE_SHIP_LENGTH - SMALL_SHIP_LENGTH >= 2
+	PLACE_TABLE(LARGE_SHIP_LENGTH - 2),
+#endif
+#if LARGE_SHIP_LENGTH - SMALL_SHIP_LENGTH >= 3
+	PLACE_TABLE(LARGE_SHIP_LENGTH - 3),
+#endif
+#if LARGE_SHIP_LENGTH - SMALL_SHIP_LENGTH >= 4
+#error "the constant placement tables cover at most four ship lengths"
+#endif
+};
+rowWord customPlaceStarts[SHIP_COUNT][2][MAX_BOARD_HEIGHT];
+const rowWord (*placeStarts)[2][MAX_BOARD_HEIGHT] = defaultPlaceStarts;
+
+// Byte Tables (built at compile time, one entry per byte value, so the link
+// and coordinate code look a byte up instead of working it out: its parity,
+// its SECDED decoding, and its value as a row letter or a column digit)
+#define REPEAT256(m) REPEAT64(m, 0, 0), REPEAT64(m, 64, 0), REPEAT64(m, 128, 0), REPEAT64(m, 192, 0)
+#define PARITY_OF(n) (((n) ^ (n) >> 1 ^ (n) >> 2 ^ (n) >> 3 ^ (n) >> 4 ^ (n) >> 5 ^ (n) >> 6 ^ (n) >> 7) & 1)
+#define PARITY_ENTRY(base, unused, i) PARITY_OF((base) + (i))
+const unsigned char parityTable[256] = {REPEAT256(PARITY_ENTRY)};
+#define SECDED_CORRECTED 0x40
+#define SECDED_SPOILED 0x80
+#define SYNDROME_OF(n) (((n) >> 1 & 1) ^ ((n) >> 2 & 1) * 2 ^ ((n) >> 3 & 1) * 3 ^ \
+		((n) >> 4 & 1) * 4 ^ ((n) >> 5 & 1) * 5 ^ ((n) >> 6 & 1) * 6 ^ ((n) >> 7 & 1) * 7)
+#define SECDED_FIXED(n) (PARITY_OF(n) ? (n) ^ (1 << SYNDROME_OF(n)) : (n))
+#define SECDED_DATA(c) (((c) >> 3 & 1) | ((c) >> 4 & 0xE))
+#define SECDED_OF(n) (PARITY_OF(n) ? SECDED_CORRECTED | SECDED_DATA(SECDED_FIXED(n)) : \
+		SYNDROME_OF(n) ? SECDED_SPOILED : SECDED_DATA(n))
+#define SECDED_ENTRY(base, unused, i) SECDED_OF((base) + (i))
+const unsigned char secdedTable[256] = {REPEAT256(SECDED_ENTRY)};
+#define CHAR_LETTER 0x40
+#define CHAR_DIGIT 0x20
+#define CHAR_VALUE 0x1F
+#define CHAR_OF(c) ((c) >= 'A' && (c) <= 'Z' ? CHAR_LETTER | ((c) - '@') : \
+		(c) >= '0' && (c) <= '9' ? CHAR_DIGIT | ((c) - '0') : 0)
+#define CHAR_ENTRY(base, unused, i) CHAR_OF((base) + (i))
+const unsigned char charTable[256] = {REPEAT256(CHAR_ENTRY)};
+
+// CPU Player (for every enemy cell, how many ship placements still fit over it
+// and how many hits those placements already contain; both are kept up to
+// date shot by shot as the results come in. Once a ship is reported sunk its
+// length no longer counts and its cells block every placement, and the maps
+// are rebuilt without them)
+#define AI_HIT_WEIGHT 8
+// (the maps are boardWidth * boardHeight bytes each, row by row, and the cells
+// of the sunk ships boardHeight rows; they live in whatever block holds the
+// rest of the player's state. A sunk ship whose cells could not be told apart
+// from its hits is kept with x set to 0)
+struct aiState {
+	unsigned char *density;
+	unsigned char *boost;
+	unsigned int hitWeight;
+	unsigned int seed;
+	unsigned char afloat;
+	unsigned char sunkCount;
+	struct ship sunkShips[SHIP_COUNT];
+	rowWord *sunk;
+};
+
+// Default Density (the density map of an empty default-size board: a cell is
+// covered by every start of a ship that reaches it without running off the
+// board, counted separately along its row and its column)
+#define COVER_RUN(c, length, extent) ((c) >= (extent) ? 0 : \
+		MIN_OF((c), (extent) - (length)) - MAX_OF(0, (c) - (length) + 1) + 1)
+#define COVER_LENGTH(c, r, length) ((length) < SMALL_SHIP_LENGTH ? 0 : \
+		(r) >= DEFAULT_HEIGHT || (c) >= DEFAULT_WIDTH ? 0 : \
+		COVER_RUN(c, length, DEFAULT_WIDTH) + COVER_RUN(r, length, DEFAULT_HEIGHT))
+#define COVER_CELL(r, unused, c) (COVER_LENGTH(c, r, LARGE_SHIP_LENGTH) + \
+		COVER_LENGTH(c, r, LARGE_SHIP_LENGTH - 1) + COVER_LENGTH(c, r, LARGE_SHIP_LENGTH - 2) + \
+		COVER_LENGTH(c, r, LARGE_SHIP_LENGTH - 3))
+#define COVER_CELLS8(r, c) COVER_CELL(r, 0, (c)), COVER_CELL(r, 0, (c) + 1), COVER_CELL(r, 0, (c) + 2), \
+		COVER_CELL(r, 0, (c) + 3), COVER_CELL(r, 0, (c) + 4), COVER_CELL(r, 0, (c) + 5), \
+		COVER_CELL(r, 0, (c) + 6), COVER_CELL(r, 0, (c) + 7)
+#if MAX_BOARD_WIDTH == 16
+#define COVER_ROW(unused, unused2, r) {COVER_CELLS8(r, 0), COVER_CELLS8(r, 8)}
+#elif MAX_BOARD_WIDTH == 64
+#define COVER_ROW(unused, unused2, r) {COVER_CELLS8(r, 0), COVER_CELLS8(r, 8), COVER_CELLS8(r, 16), \
+		COVER_CELLS8(r, 24), COVER_CELLS8(r, 32), COVER_CELLS8(r, 40), COVER_CELLS8(r, 48), \
+		COVER_CELLS8(r, 56)}
+#else
+#error "the constant board tables cover a MAX_BOARD_WIDTH of 16 or 64"
+#endif
+#define MIN_OF(a, b) ((a) < (b) ? (a) : (b))
+#define MAX_OF(a, b) ((a) > (b) ? (a) : (b))
+const unsigned char defaultDensity[MAX_BOARD_HEIGHT][MAX_BOARD_WIDTH] = {
+	REPEAT_ROWS(COVER_ROW, 0, 0)
+};
+unsigned char cpuPlay = 0;
+
+// Game Context (everything one game needs: the message buffers, the shot
+// coordinates, the replay history of the link, the fleet and the CPU player,
+// followed in the same block by the three boards, the CPU player's sunk rows
+// and maps and the fleet index, so a context takes gameContextSize() bytes for the current
+// board size. The fleet index holds, for each cell of your board, which of
+// your ships covers it, and is only read for cells still on your board, so
+// it needs no clearing; shipAfloat counts the cells of each ship not yet hit.
+// Only a context created with sram set mirrors its boards to the SRAM, and
+// only one without a linkSend hook talks to the data link itself; the rx
+// fields hold the frame being received while it is still incomplete)
+struct gameContext {
+	unsigned char inputBuffer[bufLen];
+	unsigned char outputBuffer[bufLen];
+	unsigned char sentFrames[FRAME_HISTORY][bufLen];
+	unsigned char sentFrameCount;
+	unsigned char awaitingReplay;
+	unsigned char pendingResult;
+	unsigned char sram;
+	unsigned char enemyHits;
+	unsigned char yourHits;
+	unsigned char shipCount;
+	unsigned int yourShotX;
+	unsigned int yourShotY;
+	unsigned int theirShotX;
+	unsigned int theirShotY;
+	struct ship fleetShips[SHIP_COUNT];
+	unsigned char shipAfloat[SHIP_COUNT];
+	unsigned char *shipCells;
+	unsigned int placeSeed;
+	struct aiState ai;
+	unsigned char rxIndex;
+	unsigned char rxStatus;
+	unsigned char rxEscape;
+	unsigned char rxMarker;
+	unsigned char rxSunk;
+	unsigned char frameMarker;
+	unsigned char txSeq;
+	unsigned char rxSeq;
+	unsigned char sentSeqs[FRAME_HISTORY];
+	unsigned int rxPacked;
+	unsigned int txTicket;
+	unsigned char logBuffer[LOG_PENDING * LOG_EVENT_SIZE];
+	unsigned char logPending;
+	unsigned int logLength;
+	unsigned char player;
+	unsigned char yourTurn;
+	void (*linkSend)(struct gameContext *game, unsigned char frame);
+	void *linkData;
+	rowWord boardDirty[(MAX_BOARD_ROWS + ROW_WORD_BITS - 1) / ROW_WORD_BITS];
+	rowWord *boards;
+};
+#define GAME_ARENA_SIZE (sizeof(struct gameContext) + (MAX_BOARD_ROWS + MAX_BOARD_HEIGHT) * sizeof(rowWord) + \
+		3 * MAX_BOARD_WIDTH * MAX_BOARD_HEIGHT)
+rowWord gameArena[(GAME_ARENA_SIZE + sizeof(rowWord) - 1) / sizeof(rowWord)];
 
 /**
- * charToInt() takes a character and returns the
- * corresponding integer, based on the Battleship
- * game rules. ('A' and '1' return 1, 'B' and '2'
- * return 2, etc)
+ * bitsFor() returns the number of bits needed
+ * to hold a zero-based index below n
  */
-unsigned int charToInt(unsigned char c) {
-    return c > '@' ? c - '@' : c - '0';
+unsigned int bitsFor(unsigned int n) {
+	unsigned int bits = 0;
+	while ((1U << bits) < n) {
+		bits++;
+	}
+	return bits;
 }
 
 /**
- * enterString() allows the user to fill the
- * output buffer with a string of characters
- * ending with a null terminator
+ * buildPlacementMasks() points placeStarts at the constant table
+ * for the default size, or fills the RAM table for any other: a
+ * horizontal ship of length n may start in any column up to the
+ * width minus n + 1, a vertical one in any row up to the height
+ * minus n + 1
  */
-void enterString() {
-	int i = 0;
-	unsigned char c = alt_getchar();
-	while (c != '\n') {
-		outputBuffer[i] = c;
-		c = alt_getchar();
-		i++;
+void buildPlacementMasks() {
+	int length;
+	int r;
+	rowWord columns;
+	if (boardWidth == BOARD_WIDTH && boardHeight == BOARD_HEIGHT) {
+		placeStarts = defaultPlaceStarts;
+		return;
+	}
+	for (length = SMALL_SHIP_LENGTH; length <= LARGE_SHIP_LENGTH; length++) {
+		columns = fullRow & ~(((rowWord) 1 << (length - 1)) - 1);
+		for (r = 0; r < MAX_BOARD_HEIGHT; r++) {
+			customPlaceStarts[LARGE_SHIP_LENGTH - length][PLACE_HORIZONTAL][r] =
+					r < boardHeight ? columns : 0;
+			customPlaceStarts[LARGE_SHIP_LENGTH - length][PLACE_VERTICAL][r] =
+					r + length <= boardHeight ? fullRow : 0;
+		}
 	}
-	outputBuffer[i] = '\0';
+	placeStarts = (const rowWord (*)[2][MAX_BOARD_HEIGHT]) customPlaceStarts;
 }
 
 /**
- * checkIndex() returns 0 if the given
- * index is within the bounds of the game
- * board, and 1 otherwise
+ * setBoardSize() sets the board dimensions and derives
+ * the SRAM row size and the binary wire frame count from
+ * them. Returns 1 if the size is not supported
  */
-int checkIndex(int x, int y) {
-    if (x >= 0 && x <= BOARD_WIDTH &&
-        y >= 0 && y <= BOARD_HEIGHT) {
-        return 0;
-    }
-    return 1;
+int setBoardSize(unsigned int width, unsigned int height) {
+	if (width < LARGE_SHIP_LENGTH || width > MAX_BOARD_WIDTH ||
+			height < LARGE_SHIP_LENGTH || height > MAX_BOARD_HEIGHT) {
+		return 1;
+	}
+	boardWidth = width;
+	boardHeight = height;
+	rowBytes = (width + 7) / 8;
+	fullRow = width == ROW_WORD_BITS ? ~(rowWord) 0 : ((rowWord) 1 << width) - 1;
+	rowBits = bitsFor(height);
+	columnBits = bitsFor(width);
+	wireFrames = (1 + rowBits + columnBits + 6) / 7;
+	buildPlacementMasks();
+	return 0;
 }
 
 /**
- * computeParity takes a character,
- * calculates its parity, and returns
- * it as an unsigned char
+ * gameContextSize() returns the number of bytes a game
+ * context with its boards, sunk rows and maps takes at
+ * the current board size (at most GAME_ARENA_SIZE)
  */
-unsigned char computeParity(char character) {
-	character ^= character >> 4;
-	character ^= character >> 2;
-	character ^= character >> 1;
-	character &= 1;
-	return character;
+unsigned int gameContextSize() {
+	return sizeof(struct gameContext) + (boardRows + boardHeight) * sizeof(rowWord) + 3 * boardWidth * boardHeight;
 }
 
 /**
- * createByte is a utility function that takes
- * an index and returns an 8 bit binary (char)
- * that is zero everywhere besides that index
+ * gameContextInit() lays out a cleared game context for
+ * the current board size in the given block of
+ * gameContextSize() bytes (aligned for a rowWord) and
+ * returns it. Its boards only reach the SRAM if sram is set
  */
-unsigned char createByte(int x) {
-	unsigned char c = 1;
-	return c << (BOARD_WIDTH - x);
+struct gameContext *gameContextInit(void *memory, int sram) {
+	struct gameContext *game = memory;
+	memset(game, 0, gameContextSize());
+	game->boards = (rowWord *) (game + 1);
+	game->ai.sunk = game->boards + boardRows;
+	game->ai.density = (unsigned char *) (game->ai.sunk + boardHeight);
+	game->ai.boost = game->ai.density + boardWidth * boardHeight;
+	game->shipCells = game->ai.boost + boardWidth * boardHeight;
+	game->pendingResult = RESULT_NONE;
+	game->placeSeed = 1;
+	game->sram = sram;
+	return game;
 }
 
 /**
- * sendChar sends a single character across
- * the data link between the two FPGA boards
+ * conWrite() writes up to limit bytes of what the console
+ * buffer holds and has not yet written to the console, in
+ * a single write (timed as rendering in benchmark builds),
+ * and empties the buffer once all of it has been written
  */
-void sendChar(char c) {
-	alt_printf("currently sending ");
-	alt_putchar(c);
-	alt_putchar('\n');
-	sent = c;
-	parity = sent;
-	parity = computeParity(parity);
-	sent <<= 1;
-	sent = parity + sent;
-	*data_out = sent;
-	usleep(5);
-	*load = 1;
-	usleep(5);
-	*trans_en = 1;
-	usleep(5);
-	*load = 0;
-	while (*char_sent == 0) {
-		alt_printf("");
+void conWrite(unsigned int limit) {
+	unsigned int count = conLength - conSent;
+	BENCH_START(start);
+	if (count > limit) {
+		count = limit;
+	}
+	write(STDOUT_FILENO, conBuffer + conSent, count);
+	conSent += count;
+	if (conSent == conLength) {
+		conSent = 0;
+		conLength = 0;
 	}
-	*trans_en = 0;
-	usleep(100);
+	BENCH_STOP(PHASE_RENDER, start);
 }
 
 /**
- * readString() reads a null-terminated
- * string of characters being sent from
- * the other player's FPGA board and
- * stores it to the input buffer
+ * conFlush() writes everything left in the console
+ * buffer to the console in one go, keeping the link
+ * transmit queue moving on either side of it, and
+ * leaves the buffer empty
  */
-int readString() {
-	int i = 0;
-	unsigned char received = 1;
-	while (received != '\0') {
-		if (*char_recv) {
-			received = *data_in;
-			parity = received & 1;
-			received >>= 1;
-			if (computeParity(received) == parity) {
-				inputBuffer[i] = received;
-				*char_read = 1;
-				usleep(5);
-				*char_read = 0;
-			} else {
-				alt_printf("Error: Received byte \"%c\" which has incorrect parity bit\n", *data_in);
-				*char_read = 1;
-				usleep(5);
-				*char_read = 0;
-				return 1;
-			}
-			i++;
-		}
+void conFlush() {
+	if (conLength > conSent) {
+		pumpLink();
+		conWrite(conLength - conSent);
+		pumpLink();
 	}
-	return 0;
+	conSent = 0;
+	conLength = 0;
 }
 
 /**
- * sendString() sequentially sends each
- * of the characters in the null-terminated
- * string that is contained within the
- * output buffer
+ * conPutchar() appends a character to the console
+ * buffer, flushing it first if it is full. While
+ * conMuted is set the character is dropped
  */
-void sendString() {
-	int i;
-	for (i = 0; i < bufLen; i++) {
-		if (outputBuffer[i] == '\0') {
-			sendChar(outputBuffer[i]);
-			break;
-		} else {
-			sendChar(outputBuffer[i]);
-		}
+void conPutchar(char c) {
+	if (conMuted) {
+		return;
+	}
+	if (conLength == CON_BUFFER_SIZE) {
+		conFlush();
 	}
+	conBuffer[conLength++] = c;
 }
 
 /**
- * prinInput() prints the null-terminated
- * string contained within the input buffer
+ * conPuts() appends a null-terminated string
+ * to the console buffer
  */
-void printInput() {
-	int i = 0;
-	while (inputBuffer[i] != '\0') {
-		alt_putchar(inputBuffer[i]);
-		i++;
+void conPuts(const char *str) {
+	while (*str != '\0') {
+		conPutchar(*str++);
 	}
-	alt_putchar('\n');
 }
 
 /**
- * readSRAM() returns the byte inside
- * the SRAM pointed to by the given integer
- * address (between 0 and 2047)
+ * conHex() appends an unsigned integer to the
+ * console buffer in lowercase hexadecimal
  */
-unsigned char readSRAM(int addr) {
-	unsigned char out;
-	*address = addr;
-	*notOutEn = 0;
-	out = *data;
-	usleep(10);
-	*notOutEn = 1;
-	return out;
+void conHex(unsigned int n) {
+	if (n >= 16) {
+		conHex(n >> 4);
+	}
+	conPutchar("0123456789abcdef"[n & 0xF]);
 }
 
 /**
- * writeSRAM() stores the given byte
- * at the given zero-based integer
- * address in SRAM (between 0 and 2047)
+ * conDecimal() appends an unsigned integer to
+ * the console buffer in decimal
  */
-void writeSRAM(int addr, unsigned char byte) {
-	*address = addr;
-	*data = byte;
-	*readnWrite = 0;
-	usleep(1);
-	*readnWrite = 1;
+void conDecimal(unsigned long long n) {
+	if (n >= 10) {
+		conDecimal(n / 10);
+	}
+	conPutchar('0' + n % 10);
 }
 
 /**
- * checkMove() checks the given board
- * to see if the given index is set high already
- * and returns 1 if it is set high.
+ * conPrintf() formats into the console buffer the same
+ * way alt_printf() formats to the console, accepting
+ * the %c, %s, %x and %% conversions, plus %u for an
+ * unsigned long long printed in decimal (skipping the
+ * formatting altogether while conMuted is set)
  */
-int checkMove (unsigned int x, unsigned int y, unsigned int boardAddr) {
-    unsigned char byte;
-	byte = readSRAM(boardAddr + (y - 1));
-	byte = byte >> (BOARD_WIDTH - x);
-	return byte & 1;
+void conPrintf(const char *format, ...) {
+	va_list args;
+	if (conMuted) {
+		return;
+	}
+	va_start(args, format);
+	for (; *format != '\0'; format++) {
+		if (*format != '%' || format[1] == '\0') {
+			conPutchar(*format);
+			continue;
+		}
+		format++;
+		switch (*format) {
+		case 'c':
+			conPutchar(va_arg(args, int));
+			break;
+		case 's':
+			conPuts(va_arg(args, const char *));
+			break;
+		case 'x':
+			conHex(va_arg(args, unsigned int));
+			break;
+		case 'u':
+			conDecimal(va_arg(args, unsigned long long));
+			break;
+		case '%':
+			conPutchar('%');
+			break;
+		default:
+			conPutchar('%');
+			conPutchar(*format);
+		}
+	}
+	va_end(args);
 }
 
+#ifdef HOST_SIM
 /**
- * translateOutputBuffer() reads the current
- * two-character index that is stored in the output
- * buffer, converts it from the traditional
- * Battleship index notation (e.g. 'A1' or 'C7') to
- * normal integers (handier when in the program for shifting
- * bytes or working with SRAM)
+ * halSramRead() returns the byte inside
+ * the emulated SRAM pointed to by the given
+ * integer address (between 0 and 2047)
  */
-void translateOutputBuffer() {
-	yourShotY = charToInt(outputBuffer[0]);
-	yourShotX = charToInt(outputBuffer[1]);
+unsigned char halSramRead(int addr) {
+	return hostSram[addr % SRAM_SIZE];
 }
 
 /**
- * translateInputBuffer() serves the same function as
- * translateOutputBuffer(), except for the input buffer
+ * halSramWrite() stores the given byte
+ * at the given zero-based integer
+ * address in the emulated SRAM
  */
-void translateInputBuffer() {
-	theirShotY = charToInt(inputBuffer[0]);
-	theirShotX = charToInt(inputBuffer[1]);
+void halSramWrite(int addr, unsigned char byte) {
+	hostSram[addr % SRAM_SIZE] = byte;
 }
 
 /**
- * updateEnemyBoard() stores a new state of one
- * of the enemy game boards in SRAM. Which game board
- * (shots you have made on their board, or hits you
- * have made on their board) is determined by the base
- * address passed to the function. The update that
- * is made is based the value of the global variables
- * yourShotX and yourShotY; the index indicated by
- * those values will be set high in the board that is passed
+ * halSramReadBlock() reads len consecutive bytes
+ * starting at the given emulated SRAM address into buf
  */
-void updateEnemyBoard(int board) {
-	unsigned char row;
-	row = readSRAM(yourShotY - 1 + board);
-	alt_printf("Current values at row %x: %x\n", yourShotY, row);
-	unsigned char newRow;
-	newRow = row | createByte(yourShotX);
-	alt_printf("Inserting at row %x: %x\n", yourShotY, newRow);
-	writeSRAM(yourShotY - 1 + board, newRow);
+void halSramReadBlock(int addr, unsigned char *buf, int len) {
+	int i;
+	for (i = 0; i < len; i++) {
+		buf[i] = hostSram[(addr + i) % SRAM_SIZE];
+	}
 }
 
 /**
- * updateYourBoard() uses the global variables theirShotX and
- * theirShotY to update your game board. The function determines
- * whether the enemy's shot was a hit or miss, indicates this on the
- * console, and updates your game board and boat count
+ * halSramWriteBlock() stores len bytes from buf at
+ * consecutive emulated SRAM addresses starting at addr
  */
-void updateYourBoard() {
-	int hit;
-    unsigned char byte = readSRAM(boardBase + theirShotY - 1);
-    alt_printf("The row byte for row %x is %x \n", theirShotY, byte);
-	hit = (byte >> (BOARD_WIDTH - theirShotX)) & 0x01;
-	if (hit) {
-		alt_printf("Enemy got a hit\n");
-		writeSRAM(boardBase + theirShotY - 1, ~createByte(theirShotX) & byte);
-		enemyHits++;
-		outputBuffer[0] = '1';
-		outputBuffer[1] = '\0';
-	} else {
-		alt_printf("Enemy has missed\n");
-		outputBuffer[0] = '0';
-		outputBuffer[1] = '\0';
+void halSramWriteBlock(int addr, const unsigned char *buf, int len) {
+	int i;
+	for (i = 0; i < len; i++) {
+		hostSram[(addr + i) % SRAM_SIZE] = buf[i];
 	}
 }
 
 /**
- * printEnemyBoard() returns void
- * Prints an ASCII representation of the enemy's current board state
- * Confirmed hits are marked with "X", Missed shots are marked with "O",
- * empty space is marked with "-"
+ * hostMapSram() backs the emulated SRAM with the given
+ * file, so it outlives the program like the real SRAM
+ * outlives a reset of the board. Returns 1 on failure
  */
-void printEnemyBoard() {
-	unsigned char byteShot;
-	unsigned char byteHit;
-	int ishift;
-	int ishot = shotsBase;
-	int ihit = hitsBase;
-	int bitShot;
-	int bitHit;
-	alt_printf("Current assessment of enemy territory...\n");
-	alt_printf("  1 2 3 4 5 6 7 8\n");
-	while (ishot < shotsBase + 8) {
-		alt_printf("%c ", 'A' + ishot - shotsBase);
-		byteShot = readSRAM(ishot);
-		byteHit = readSRAM(ihit);
-		for (ishift = 7; ishift >= 0; ishift--) {
-			bitShot = (byteShot >> ishift) & 0x01;
-			bitHit = (byteHit >> ishift) & 0x01;
-			if (bitShot & bitHit) {
-				alt_putchar('X');
-			} else if (bitShot) {
-				alt_putchar('O');
-			} else {
-				alt_putchar('-');
-			}
-			alt_putchar(' ');
-		}
-		alt_printf("\n");
-		ishot++;
-		ihit++;
+int hostMapSram(const char *path) {
+	void *memory;
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || ftruncate(fd, SRAM_SIZE) < 0) {
+		perror(path);
+		return 1;
 	}
-	alt_printf("\n");
+	memory = mmap(0, SRAM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		perror(path);
+		return 1;
+	}
+	hostSram = memory;
+	return 0;
 }
 
 /**
- * printYourBoard() returns void
- * Prints an ASCII representation of a player's current board state
- * Boats are marked with "B", empty space is marked with "-"
+ * benchNow() returns the host monotonic clock in nanoseconds
  */
-void printYourBoard() {
-	unsigned char byteBoard;
-	int ishift;
-	int iboard = boardBase;
-	int bitBoard;
-	alt_printf("Your fleet...\n");
-	alt_printf("  1 2 3 4 5 6 7 8\n");
-	while (iboard < boardBase + 8) {
-		alt_printf("%c ", 'A' + iboard - boardBase);
-		byteBoard = readSRAM(iboard);
-		for (ishift = 7; ishift >= 0; ishift--) {
-			bitBoard = (byteBoard >> ishift) & 0x01;
-			if (bitBoard) {
-				alt_putchar('B');
-			} else {
-				alt_putchar('-');
-			}
-			alt_putchar(' ');
-		}
-		alt_printf("\n");
-		iboard++;
-	}
-	alt_printf("\n");
+unsigned long long benchNow() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
 }
 
 /**
- * eraseSRAM() returns void
- * Routine to clear all data on the SRAM
+ * benchFreq() returns the number of benchNow() ticks per second
  */
-void eraseSRAM() {
-	int i;
-	for (i = 0; i < 30; i++) {
-		writeSRAM(i, 0);
-	}
+unsigned long long benchFreq() {
+	return 1000000000ULL;
 }
 
 /**
- * setIndexHigh() return void
- * Accepts integers x and y for coordinates, and a base address for a game board
- * Uses the coordinates to "turn on" a bit at that location on the given board
+ * halLinkInit() has nothing to prepare on the host; the
+ * socket is opened by hostInit() before the game starts
  */
-void setIndexHigh (int x, int y, int base) {
-	unsigned char byte;
-	byte = readSRAM(base + y - 1);
-	byte = createByte(x) | byte;
-	writeSRAM(base + y - 1, byte);
+void halLinkInit() {
 }
 
+/**
+ * halLinkWrite() writes as many of the count coded bytes
+ * as the link socket takes without blocking, and returns
+ * how many that was. Once the other player has hung up the
+ * bytes are dropped, and the next wait on the link ends the
+ * program (a lingering loser just stops); any other error
+ * ends it at once
+ */
+int halLinkWrite(const unsigned char *bytes, int count) {
+	ssize_t sent = send(hostLinkFd, bytes, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (sent < 0 && (errno == EPIPE || errno == ECONNRESET)) {
+		hostLinkClosed = 1;
+		return count;
+	}
+	if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+		perror("link send");
+		exit(1);
+	}
+	return sent < 0 ? 0 : sent;
+}
 
+/**
+ * halLinkBusy() returns 0, as a byte the socket
+ * has taken needs nothing more from us
+ */
+int halLinkBusy() {
+	return 0;
+}
 
 /**
- * setUpBoats() returns void
- * Initializes game by placing the player's boats on their board
- * sizes of the boats are bound by LARGE_SHIP_LENGTH and SMALL_SHIP_LENGTH
- * where each subsequent boat will be 1 unit smaller than before
- * The user will be prompted for a coordinate and an orientation
- * 'v' assumes the ship is placed at the given coordinate and continued down
- * 'h' assumes the ship is placed at the given coordinate and continued right
+ * halLinkReceive() returns the next byte waiting on the
+ * link socket, or -1 if none has arrived yet (or the
+ * other player has closed the link)
  */
-void setUpBoats() {
-    int i;
-	int j;
-	int check = 0;
-	unsigned char xCoor;
-	unsigned char yCoor;
-	unsigned char orientation;
-	printYourBoard();
-	for (i = LARGE_SHIP_LENGTH; i >= SMALL_SHIP_LENGTH; i--) {
-		do {
-			alt_printf("Please choose coordinates for your length %x ship: ", i);
-			yCoor = charToInt(alt_getchar());
-			xCoor = charToInt(alt_getchar());
-			alt_getchar();
-			do {
-				alt_printf("Please choose either vertical or horizontal orientation (v or h): ");
-				orientation = alt_getchar();
-				alt_getchar();
-			} while (orientation != 'h' && orientation != 'v');
-
-			for (j = i - 1; j >= 0; j--) {
-				if (orientation == 'v') {
-					check = checkMove(xCoor, yCoor + j, boardBase) ||
-							checkIndex(xCoor, yCoor + j);
-				} else {
-					check = checkMove(xCoor + j, yCoor, boardBase) ||
-							checkIndex(xCoor + j, yCoor);
-				}
-				if (check) {
-					alt_printf("Sorry, that location is off the map or already taken\n");
-					break;
-				}
-			}
+int halLinkReceive() {
+	unsigned char frame;
+	ssize_t n;
+	if (hostLinkClosed) {
+		return -1;
+	}
+	n = recv(hostLinkFd, &frame, 1, MSG_DONTWAIT);
+	if (n == 1) {
+		return frame;
+	}
+	if (n == 0) {
+		hostLinkClosed = 1;
+	}
+	return -1;
+}
 
-			if (!check) {
-				for (j = i - 1; j >= 0; j--) {
-					if (orientation == 'v') {
-						setIndexHigh(xCoor, yCoor + j, boardBase);
-					} else {
-						setIndexHigh(xCoor + j, yCoor, boardBase);
-					}
-				}
-			}
-		} while (check);
-		printYourBoard();
-	}
-}
-
-int main() {
-	alt_printf("+ooooooo++:`      /oooooooo.  .ooooooooooooo oooooooooooo+ /ooooo-    -ooooooooo+   .+shhhhyo:    /ooooo  /ooooo- `oooooo  :ooooooo++:`\n");
-	alt_printf("dMMMMMMMMMMMh.    mMMMMMMMMs  :MMMMMMMMMMMMM MMMMMMMMMMMMm dMMMMM/    +MMMMMMMMMd  yMMMMMMMMMMN:  yMMMMM  hMMMMM+ .MMMMMM  sMMMMMMMMMMMh`\n");
-	alt_printf("dMMMMMysNMMMMd   .MMMMMMMMMm  -mmmNMMMMMNmmm mmmMMMMMMmmmh dMMMMM/    +MMMMMNmmmy +MMMMM  NMMMMd  yMMMMM  hMMMMM+ .MMMMMM  sMMMMMdsmMMMMo\n");
-    alt_printf("dMMMMM   MMMMM   +MMMMNmMMMM.     yMMMMMo       NMMMMM-    dMMMMM/    +MMMMMh     sMMMMM  dMMMMN  yMMMMM  hMMMMM+ .MMMMMM  sMMMMM   MMMMy\n");
-    alt_printf("dMMMMM   MMMMN   yMMMMhhMMMM+     yMMMMMo       NMMMMM-    dMMMMM/    +MMMMMh     /MMMMMNo        yMMMMM  dMMMMM+ .MMMMMM  sMMMMM   MMMMy\n");
-    alt_printf("dMMMMMNNMMMms-   NMMMM  MMMMh     yMMMMMo       NMMMMM-    dMMMMM/    +MMMMMMNNNo  sMMMMMMMms-    yMMMMMMMMMMMMM+ .MMMMMM  sMMMMM  NMMMMs\n");
-    alt_printf("dMMMMMNMMMMMm+  -MMMMM  MMMMM`    yMMMMMo       NMMMMM-    dMMMMM/    +MMMMMMMMMo   .omMMMMMMMd-  yMMMMMMMMMMMMM+ .MMMMMM  sMMMMMMMMMMMm.\n");
-    alt_printf("dMMMMM   MMMMM: oMMMMM  MMMMM/    yMMMMMo       NMMMMM-    dMMMMM/    +MMMMMd:::.      -sNMMMMMN` yMMMMM  dMMMMM+ .MMMMMM  sMMMMMdoo+/-\n");
-    alt_printf("dMMMMM   MMMMM+ hMMMMMMMMMMMMy    yMMMMMo       NMMMMM-    dMMMMM/    +MMMMMh     /MMMMM:  MMMMM/ yMMMMM  hMMMMM+ .MMMMMM  sMMMMMs\n");
-    alt_printf("dMMMMM   MMMMM+`MMMMMMMMMMMMMN    yMMMMMo       NMMMMM-    dMMMMM+... +MMMMMh.... :MMMMM/  MMMMM+ yMMMMM  hMMMMM+ .MMMMMM  sMMMMMs\n");
-    alt_printf("dMMMMMmNMMMMMM::MMMMMN  dMMMMM-   yMMMMMo       NMMMMM-    dMMMMMMMMM`+MMMMMMMMMM-`NMMMMdsmMMMMM- yMMMMM  hMMMMM+ .MMMMMM  sMMMMMs\n");
-    alt_printf("dMMMMMMMMMMMNo sMMMMMh  yMMMMMs   yMMMMMo       NMMMMM-    dMMMMMMMMM`+MMMMMMMMMM- .yNMMMMMMMMd:  yMMMMM  hMMMMM+ .MMMMMM  sMMMMMs\n");
-    alt_printf(".--------..`   .-----.  `-----.   .-----`       ------`    .--------- `----------     -/+++/-`    .-----` .-----`  ------  `-----.\n");
-    alt_printf("                                                                           ```-y:`\n");
-    alt_printf("                                                                           ../smmo- \n");
-    alt_printf("                                                                           -  .mh\n");
-    alt_printf("                                                                        `mNm``dh\n");
-	alt_printf("                                                                       :/yNo..dh\n");
-	alt_printf("                                                                       dmNNNNmNh\n");
-	alt_printf("                                                                 `+o:`   -dd+/s.\n");
-	alt_printf("                                                                 hNNNN-  :dhy.\n");
-	alt_printf("                                                            ...-://dNh-.`-dys\n");
-    alt_printf("                                                        .:/:..-ydNNNNNNNh:dyy\n");
-	alt_printf("                                                      -dNNNNNh.`:NNNNNNNm:dyd/y:\n");
-	alt_printf("                                                      yNNNNNNNy .NNNNNNNm:NNmyNo\n");
-	alt_printf("                                                     hNNNNNNNh-+NNNNNNNNNNNdoo:\n");
-	alt_printf("  ``:                                             ... dNNNNNNNNNNNNNNNNNNNNNN//-\n");
-	alt_printf("sNNNy                                            .NNNmNNNNNNNNNNNNNNNNNNNNNNNyys++`\n");
-	alt_printf("/Nms+o                           ``````           yNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNmhyo+:-`         :oo-.`+ys:.`                    `\n");
-	alt_printf(":-   :                   ``  ``:hNNNNNN+          NNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNdooooo/`-mNNm/+NNNm/.                   ++\n");
-	alt_printf("     :                   ..--/hNNNNNNNNy         .NNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNmhhhmhyyy+    `.   oN/\n");
-	alt_printf("    :/.-.:..:.-..:..-..-..-..-ydNNNNNNNo-++/-```-+NNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNN.  -mNo `hh-\n");
-	alt_printf("    `omNNNmmmmmdddhhhyyhssyoossmNNNNNNNhdNNNNyooNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNy-+NNNN+/+++:-..\n");
-	alt_printf("      `sNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNo\n");
-	alt_printf("        .sNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNo\n");
-	alt_printf("          .hNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNN:\n");
-	alt_printf("            /NNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNm`\n");
-	alt_printf("             .hNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNmmmmmmmmmmmmmmmmmmmdddddddddddddddddhhhhhhhhhs\n");
-	alt_printf("              :hdddhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyys:\n");
-	alt_printf("            .oyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyysssssssssssssssssssssssssssssssssssssssssssssso\n");
-	alt_printf("          `/yyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssso+oooooo++++//::-\n");
-	alt_printf("        `:ssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssssossoooooooooooooooooooooooooooooooooooooooooo+  .+oo. ./.\n");
-	alt_printf("      `/osssssssssssssooooo+++/oosssoooo/ooooo:-+oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo++++++++++.   `-`  `+/\n");
-	alt_printf("     .//:::-:--:.-..-``.``.```./+oooooo+....`     /oooooooooooooooooo+++++++++++++++++++++++++++++++/:/++++:+++++:`` ``              `:`\n");
-	alt_printf("     `-```````            ```.-/++++++++.         -+++++++++++++++++++++++++++++++++++++++//:-.``     `:/:.``:::``\n");
-	alt_printf(" `    .                         `-:::---          `/++++++++++++////////////////////--..`\n");
-	alt_printf(" :/:-.-                                            .///:///////////////////////`-\n");
-	alt_printf(" `-::/-                                                 ://////:::::::::::::::-`.`\n");
-	alt_printf("                                                        -:::::::. `::::::::.::--:.\n");
-	alt_printf("                                                        .-:::::-` `--------`-.-`.`\n");
-	alt_printf("                                                          ``.`` `..-------.`...\n");
-	alt_printf("                                                                   ``...`  `...\n");
-	alt_printf("                                                                   `...`    `````\n");
-	alt_printf("                                                                          ````````\n");
-
-
-	alt_printf("Welcome to the warzone!\n");
-	alt_printf("The first rule of Battleship is that the last man standing wins. Aside from that, here are some guidelines:\n");
-	alt_printf("\t- You will place your ships, starting from your biggest ship (length %x) down to your smallest ship (length %x)\n");
-	alt_printf("\t- The game uses coordinates like A1 and C6, where A - H are valid horizontal coordinates and 1 - 8 are valid vertical coordinates\n");
-	alt_printf("\t- The commanders of the ships must agree upon the order in which the firefight shall commence (Player 1 and Player 2)\n");
-	alt_printf("\t- Once the game is underway, each side may fire upon the other as his or her turn comes by entering a coordinate to fire upon\n");
-	alt_printf("\t- Your map of the enemy territory shows O's where you have shot previously, and X's where you have shot and made a hit\n");
-	alt_printf("\t- Your ships are displayed using B's to denote where you still have ships (or fragments of ships, at least)\n");
-	alt_printf("\t- Artillery and shrapnel will follow, until such a point when either you or your enemy has succumbed to the cold blue depths of the Pacific\n");
-	alt_printf("\t- The war is over, and the victorious side may now loot and plunder the land of the loser\n\n");
-	alt_printf("Let the games begin!\n\n");
+/**
+ * halLinkOpen() returns 0 once the other
+ * player has closed the link socket
+ */
+int halLinkOpen() {
+	return !hostLinkClosed;
+}
 
-	*char_read = 1;
-	usleep(5);
-	*char_read = 0;
-	eraseSRAM();
+/**
+ * halLinkWait() sleeps until the link socket has data
+ * or HOST_WAIT_MS passes, instead of spinning (and wakes
+ * for stdin too while the key queue has room). Waiting
+ * on a link the other player has closed ends the program
+ */
+void halLinkWait() {
+	struct pollfd pfd[2];
+	int count = 1;
+	if (hostLinkClosed) {
+		conFlush();
+		fprintf(stderr, "link closed by the other player\n");
+		exit(1);
+	}
+	pfd[0].fd = hostLinkFd;
+	pfd[0].events = POLLIN;
+	if (!keyEnded && keyHead - keyTail < KEY_RING_SIZE) {
+		pfd[1].fd = STDIN_FILENO;
+		pfd[1].events = POLLIN;
+		count = 2;
+	}
+	poll(pfd, count, HOST_WAIT_MS);
+}
 
-	int i;
-	int totalHits = 0;
-	for (i = SMALL_SHIP_LENGTH; i <= LARGE_SHIP_LENGTH; i++) {
-		totalHits += i;
+/**
+ * halKeyRead() stands in for the HAL keyboard: it reads
+ * up to count keystrokes that stdin already has without
+ * waiting, and returns how many it read, or -1 once
+ * stdin has run out
+ */
+int halKeyRead(unsigned char *keys, int count) {
+	struct pollfd pfd;
+	ssize_t got;
+	pfd.fd = STDIN_FILENO;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) <= 0) {
+		return 0;
+	}
+	got = read(STDIN_FILENO, keys, count);
+	if (got < 0 && errno == EINTR) {
+		return 0;
 	}
+	return got > 0 ? got : -1;
+}
 
-	setUpBoats();
+/**
+ * hostListen() returns a socket listening on the given
+ * TCP port with the given backlog, or -1 on failure
+ */
+int hostListen(const char *port, int backlog) {
+	struct addrinfo hints;
+	struct addrinfo *info;
+	int fd;
+	int one = 1;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(0, port, &hints, &info) != 0) {
+		fprintf(stderr, "cannot resolve *:%s\n", port);
+		return -1;
+	}
+	fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+	if (fd >= 0) {
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, info->ai_addr, info->ai_addrlen) < 0 || listen(fd, backlog) < 0) {
+			perror("listen");
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(info);
+	return fd;
+}
 
-	int yourTurn;
-	int player;
-	int otherPlayer;
-	int notValidMove = 1;
-	alt_printf("Are you player 1 or 2? ");
-	player = charToInt(alt_getchar());
-	otherPlayer = 3 - player;
-	yourTurn = 2 - player;
-	alt_getchar();
-	while (yourHits != totalHits && enemyHits != totalHits) {
-		if (yourTurn) {
-			while (notValidMove) {
-				alt_printf("Please enter a coordinate to fire at: ");
-				enterString();
-				translateOutputBuffer();
-				notValidMove = checkMove(yourShotX, yourShotY, shotsBase) ||
-						checkIndex(yourShotX, yourShotY);
-			}
-			sendString();
-			readString();
-			alt_printf("Updating shots board:\n");
-			updateEnemyBoard(shotsBase);
-			translateInputBuffer();
-			if (charToInt(inputBuffer[0])) {
-				alt_printf("Updating hits board:\n");
-				updateEnemyBoard(hitsBase);
-				yourHits++;
-			}
-			printEnemyBoard();
-			printYourBoard();
-			notValidMove = 1;
-			yourTurn = 0;
-		} else {
-			alt_printf("Waiting for player %x to make a move...", otherPlayer);
-			readString();
-			translateInputBuffer();
-			alt_printf("Enemy has fired on coordinate %c%c\n", inputBuffer[0], inputBuffer[1]);
-			alt_printf("Translates to integer coordinate %x%x\n", theirShotY, theirShotX);
-			updateYourBoard();
-			sendString();
-			printEnemyBoard();
-			printYourBoard();
-			yourTurn = 1;
+/**
+ * hostOpenLink() opens the TCP link socket, either by
+ * waiting for the other player on the given port (host is
+ * NULL) or by connecting to them. Returns -1 on failure
+ */
+int hostOpenLink(const char *host, const char *port) {
+	struct addrinfo hints;
+	struct addrinfo *info;
+	int fd;
+	int listener;
+	int one = 1;
+	if (!host) {
+		listener = hostListen(port, 1);
+		if (listener < 0) {
+			return -1;
 		}
+		fprintf(stderr, "waiting for the other player on port %s\n", port);
+		fd = accept(listener, 0, 0);
+		close(listener);
+	} else {
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(host, port, &hints, &info) != 0) {
+			fprintf(stderr, "cannot resolve %s:%s\n", host, port);
+			return -1;
+		}
+		fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+		if (fd >= 0 && connect(fd, info->ai_addr, info->ai_addrlen) < 0) {
+			perror("connect");
+			close(fd);
+			fd = -1;
+		}
+		freeaddrinfo(info);
+	}
+	if (fd >= 0) {
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
 	}
+	return fd;
+}
 
-	if (yourHits == totalHits) {
-		alt_printf("You sunk all of player %x ships! Game over...", otherPlayer);
+/**
+ * hostOptions() consumes the leading --size WxH, --cpu, --fec,
+ * --log file and --sram file (and, in benchmark builds, --games N, and in analysis
+ * builds --games N and --threads N) options from the
+ * command line. Returns 1 if an option value is invalid
+ */
+int hostOptions(int *argc, char ***argv) {
+	char **args = *argv;
+	unsigned int width;
+	unsigned int height;
+	int used;
+	while (*argc >= 2 && strncmp(args[1], "--", 2) == 0) {
+		used = 2;
+		if (strcmp(args[1], "--cpu") == 0) {
+			cpuPlay = 1;
+			used = 1;
+		} else if (strcmp(args[1], "--fec") == 0) {
+			linkCode = LINK_SECDED;
+			used = 1;
+		} else if (*argc < 3) {
+			break;
+		} else if (strcmp(args[1], "--log") == 0) {
+			hostLogFile = fopen(args[2], "ab");
+			if (hostLogFile == 0) {
+				perror(args[2]);
+				return 1;
+			}
+		} else if (strcmp(args[1], "--script") == 0) {
+			hostScriptFile = fopen(args[2], "r");
+			if (hostScriptFile == 0) {
+				perror(args[2]);
+				return 1;
+			}
+		} else if (strcmp(args[1], "--sram") == 0) {
+			if (hostMapSram(args[2])) {
+				return 1;
+			}
+		} else if (strcmp(args[1], "--size") == 0) {
+			if (sscanf(args[2], "%ux%u", &width, &height) != 2 || setBoardSize(width, height)) {
+				fprintf(stderr, "board size must be WxH, from %ux%u up to %ux%u\n",
+						LARGE_SHIP_LENGTH, LARGE_SHIP_LENGTH, MAX_BOARD_WIDTH, MAX_BOARD_HEIGHT);
+				return 1;
+			}
+#ifdef BENCHMARK
+		} else if (strcmp(args[1], "--games") == 0) {
+			benchGames = atoi(args[2]);
+#endif
+#ifdef ANALYSIS
+		} else if (strcmp(args[1], "--games") == 0) {
+			analysisGames = atoi(args[2]);
+		} else if (strcmp(args[1], "--threads") == 0) {
+			analysisThreads = atoi(args[2]);
+#endif
+		} else {
+			break;
+		}
+		args[used] = args[0];
+		args += used;
+		*argc -= used;
+	}
+	*argv = args;
+	return 0;
+}
+
+/**
+ * hostScriptChar() feeds readPlan() from the
+ * --script file, returning -1 at its end
+ */
+int hostScriptChar() {
+	return fgetc(hostScriptFile);
+}
+
+/**
+ * hostInit() parses the host command line, reads the --script
+ * plan and opens the data link. Returns 0 on success and 1
+ * on a usage error or a plan that cannot be played
+ */
+int hostInit(int argc, char **argv) {
+	char *colon;
+	if (hostOptions(&argc, &argv)) {
+		return 1;
+	}
+	if (hostScriptFile != 0) {
+		scriptPlay = readPlan(hostScriptChar) == 0;
+		fclose(hostScriptFile);
+		if (!scriptPlay) {
+			conFlush();
+			return 1;
+		}
+	}
+	srand(getpid());
+	if (argc == 3 && strcmp(argv[1], "--listen") == 0) {
+		hostLinkFd = hostOpenLink(0, argv[2]);
+	} else if (argc == 3 && strcmp(argv[1], "--connect") == 0 &&
+			(colon = strrchr(argv[2], ':')) != 0) {
+		*colon = '\0';
+		hostLinkFd = hostOpenLink(argv[2], colon + 1);
+	} else {
+		fprintf(stderr, "usage: %s [--size WxH] [--cpu] [--fec] [--log file] [--sram file] [--script file]\n"
+				"       %*s --listen port | --connect host:port\n"
+				"       %s --replay file [turn]\n", argv[0], (int) strlen(argv[0]), "", argv[0]);
+		return 1;
+	}
+	return hostLinkFd < 0;
+}
+#else
+/**
+ * halSramRead() returns the byte inside
+ * the SRAM pointed to by the given integer
+ * address (between 0 and 2047)
+ */
+unsigned char halSramRead(int addr) {
+	unsigned char out;
+	*address = addr;
+	*notOutEn = 0;
+	out = *data;
+	usleep(10);
+	*notOutEn = 1;
+	return out;
+}
+
+/**
+ * halSramWrite() stores the given byte
+ * at the given zero-based integer
+ * address in SRAM (between 0 and 2047)
+ */
+void halSramWrite(int addr, unsigned char byte) {
+	*address = addr;
+	*data = byte;
+	*readnWrite = 0;
+	usleep(1);
+	*readnWrite = 1;
+}
+
+/**
+ * halSramReadBlock() reads len consecutive bytes
+ * starting at the given SRAM address into buf.
+ * Output enable stays asserted for the whole run,
+ * so the settle delay is only paid once per block
+ */
+void halSramReadBlock(int addr, unsigned char *buf, int len) {
+	int i;
+	*notOutEn = 0;
+	for (i = 0; i < len; i++) {
+		*address = addr + i;
+		buf[i] = *data;
+	}
+	usleep(10);
+	*notOutEn = 1;
+}
+
+/**
+ * halSramWriteBlock() stores len bytes from buf at
+ * consecutive SRAM addresses starting at addr.
+ * Write enable is pulsed once per byte, and only while
+ * the address and data are stable, since an asynchronous
+ * SRAM writes wherever the address lines point while it
+ * is low. Each pulse is held as long as halSramWrite()
+ * holds it
+ */
+void halSramWriteBlock(int addr, const unsigned char *buf, int len) {
+	int i;
+	for (i = 0; i < len; i++) {
+		*address = addr + i;
+		*data = buf[i];
+		*readnWrite = 0;
+		usleep(1);
+		*readnWrite = 1;
+	}
+}
+
+/**
+ * halLinkBusy() moves the handshake of the byte in flight
+ * on as far as it can go without waiting, and returns 1
+ * until it is done: char_sent rising means the other side
+ * has latched the byte, and char_sent falling again after
+ * trans_en is dropped means the link is free. In fixed mode
+ * (or if the peer does not answer in time) the worst-case
+ * gap delay stands in for the second half
+ */
+int halLinkBusy() {
+	if (linkState == LINK_SENDING) {
+		if (*char_sent == 0) {
+			return 1;
+		}
+		*trans_en = 0;
+		linkPolls = 0;
+		linkState = LINK_RELEASING;
+	}
+	if (linkState == LINK_RELEASING) {
+		if (linkHandshake == HANDSHAKE_ADAPTIVE && *char_sent != 0 && ++linkPolls < LINK_POLL_LIMIT) {
+			return 1;
+		}
+		if (linkHandshake == HANDSHAKE_FIXED || linkPolls == LINK_POLL_LIMIT) {
+			usleep(LINK_GAP_US);
+		}
+		linkState = LINK_FREE;
+	}
+	return 0;
+}
+
+/**
+ * halLinkWrite() starts the first of the count coded
+ * bytes on the data link if the link is free, without
+ * waiting for the other side to latch it, and returns
+ * how many bytes it took (0 or 1)
+ */
+int halLinkWrite(const unsigned char *bytes, int count) {
+	if (count == 0 || halLinkBusy()) {
+		return 0;
+	}
+	*data_out = bytes[0];
+	if (linkHandshake == HANDSHAKE_FIXED) {
+		usleep(LINK_SETTLE_US);
+		*load = 1;
+		usleep(LINK_SETTLE_US);
+		*trans_en = 1;
+		usleep(LINK_SETTLE_US);
+		*load = 0;
+	} else {
+		*load = 1;
+		*trans_en = 1;
+		*load = 0;
+	}
+	linkState = LINK_SENDING;
+	return 1;
+}
+
+/**
+ * takeLatchedByte() returns the byte latched on the
+ * data link and acknowledges it with char_read
+ */
+unsigned char takeLatchedByte() {
+	unsigned char frame = *data_in;
+	*char_read = 1;
+	usleep(5);
+	*char_read = 0;
+	return frame;
+}
+
+/**
+ * halLinkReceive() returns the byte waiting on the
+ * data link, or -1 if char_recv is not raised
+ */
+int halLinkReceive() {
+	if (*char_recv) {
+		return takeLatchedByte();
+	}
+	return -1;
+}
+
+/**
+ * halLinkOpen() returns 1, as the
+ * wired link cannot be closed
+ */
+int halLinkOpen() {
+	return 1;
+}
+
+/**
+ * halLinkWait() backs off for LINK_IDLE_US
+ * while waiting on the data link
+ */
+void halLinkWait() {
+	usleep(LINK_IDLE_US);
+}
+
+/**
+ * halKeyRead() takes up to count keystrokes waiting in
+ * the JTAG UART's receive FIFO, without blocking like
+ * alt_getchar() does, and returns how many it took
+ */
+int halKeyRead(unsigned char *keys, int count) {
+	unsigned int word;
+	int got = 0;
+	while (got < count) {
+		word = IORD_ALTERA_AVALON_JTAG_UART_DATA(JTAG_UART_BASE);
+		if (!(word & ALTERA_AVALON_JTAG_UART_DATA_RVALID_MSK)) {
+			break;
+		}
+		keys[got++] = word & ALTERA_AVALON_JTAG_UART_DATA_DATA_MSK;
+	}
+	return got;
+}
+
+#ifdef CHAR_RECV_IRQ
+void receiveChar(unsigned char frame);
+
+/**
+ * charRecvISR() is the interrupt handler for the
+ * char_recv line; it clears the edge capture and
+ * moves the received byte onto the receive ring
+ */
+void charRecvISR(void *context) {
+	IOWR_ALTERA_AVALON_PIO_EDGE_CAP(CHAR_RECV_BASE, 0);
+	receiveChar(takeLatchedByte());
+}
+#endif
+
+#if defined(BENCHMARK) || defined(INSTRUMENT)
+/**
+ * benchNow() returns the Nios timestamp timer count
+ */
+unsigned long long benchNow() {
+	return alt_timestamp();
+}
+
+/**
+ * benchFreq() returns the number of benchNow() ticks per second
+ */
+unsigned long long benchFreq() {
+	return alt_timestamp_freq();
+}
+#endif
+
+/**
+ * halLinkInit() clears any byte left latched on the
+ * data link and, when the system provides a char_recv
+ * interrupt, registers charRecvISR() for it
+ */
+void halLinkInit() {
+	*char_read = 1;
+	usleep(5);
+	*char_read = 0;
+#ifdef CHAR_RECV_IRQ
+	IOWR_ALTERA_AVALON_PIO_EDGE_CAP(CHAR_RECV_BASE, 0);
+	alt_ic_isr_register(CHAR_RECV_IRQ_INTERRUPT_CONTROLLER_ID, CHAR_RECV_IRQ,
+			charRecvISR, 0, 0);
+	IOWR_ALTERA_AVALON_PIO_IRQ_MASK(CHAR_RECV_BASE, 1);
+#endif
+}
+#endif
+
+/**
+ * readSRAM() returns the byte inside
+ * the SRAM pointed to by the given integer
+ * address (between 0 and 2047)
+ */
+unsigned char readSRAM(int addr) {
+	unsigned char byte;
+	BENCH_START(start);
+	PROBE_START(cycles);
+	byte = halSramRead(addr);
+	PROBE_STOP(PROBE_SRAM_READ, cycles, 1);
+	BENCH_STOP(PHASE_SRAM, start);
+	return byte;
+}
+
+/**
+ * writeSRAM() stores the given byte
+ * at the given zero-based integer
+ * address in SRAM (between 0 and 2047)
+ */
+void writeSRAM(int addr, unsigned char byte) {
+	BENCH_START(start);
+	PROBE_START(cycles);
+	halSramWrite(addr, byte);
+	PROBE_STOP(PROBE_SRAM_WRITE, cycles, 1);
+	BENCH_STOP(PHASE_SRAM, start);
+}
+
+/**
+ * readSRAMBlock() reads len consecutive bytes
+ * starting at the given SRAM address into buf
+ */
+void readSRAMBlock(int addr, unsigned char *buf, int len) {
+	BENCH_START(start);
+	PROBE_START(cycles);
+	halSramReadBlock(addr, buf, len);
+	PROBE_STOP(PROBE_SRAM_READ, cycles, len);
+	BENCH_STOP(PHASE_SRAM, start);
+}
+
+/**
+ * writeSRAMBlock() stores len bytes from buf at
+ * consecutive SRAM addresses starting at addr
+ */
+void writeSRAMBlock(int addr, const unsigned char *buf, int len) {
+	BENCH_START(start);
+	PROBE_START(cycles);
+	halSramWriteBlock(addr, buf, len);
+	PROBE_STOP(PROBE_SRAM_WRITE, cycles, len);
+	BENCH_STOP(PHASE_SRAM, start);
+}
+
+/**
+ * readKey() takes the next keystroke off the key queue,
+ * running the tasks (which also show the prompt) until
+ * the keyboard task has queued one. The program ends
+ * when the keyboard has run out
+ */
+unsigned char readKey() {
+	unsigned char c;
+	while (keyHead == keyTail) {
+		if (keyEnded) {
+			conFlush();
+			exit(0);
+		}
+		if (!runTasks()) {
+			linkIdle();
+		}
+	}
+	c = keyRing[keyTail % KEY_RING_SIZE];
+	keyTail++;
+	return c;
+}
+
+/**
+ * charToInt() takes a character and returns the
+ * corresponding integer, based on the Battleship
+ * game rules. ('A' and '1' return 1, 'B' and '2'
+ * return 2, etc; anything else returns 0)
+ */
+unsigned int charToInt(unsigned char c) {
+    return charTable[c] & CHAR_VALUE;
+}
+
+/**
+ * parseCoordinate() reads a coordinate in Battleship
+ * notation from buf: the row as letters (A - Z, then
+ * AA, AB, ... on tall boards) followed by the column as
+ * a decimal number. Stores one-based values in y and x,
+ * which are left 0 if the coordinate is malformed, and
+ * returns the number of characters read
+ */
+int parseCoordinate(const unsigned char *buf, unsigned int *y, unsigned int *x) {
+	int i = 0;
+	*y = 0;
+	*x = 0;
+	while ((charTable[buf[i]] & CHAR_LETTER) && *y <= MAX_BOARD_HEIGHT) {
+		*y = *y * 26 + (charTable[buf[i]] & CHAR_VALUE);
+		i++;
+	}
+	while ((charTable[buf[i]] & CHAR_DIGIT) && *x <= MAX_BOARD_WIDTH) {
+		*x = *x * 10 + (charTable[buf[i]] & CHAR_VALUE);
+		i++;
+	}
+	return i;
+}
+
+/**
+ * rowLabel() writes the letters naming the given
+ * one-based row into buf and returns how many it wrote
+ */
+int rowLabel(unsigned int y, unsigned char *buf) {
+	int len = 0;
+	if (y > 26) {
+		buf[len++] = '@' + (y - 1) / 26;
+	}
+	buf[len++] = 'A' + (y - 1) % 26;
+	return len;
+}
+
+/**
+ * formatCoordinate() writes the null-terminated
+ * Battleship notation of the one-based coordinate
+ * (x, y) into buf and returns its length
+ */
+int formatCoordinate(unsigned int y, unsigned int x, unsigned char *buf) {
+	int len = rowLabel(y, buf);
+	if (x >= 10) {
+		buf[len++] = '0' + x / 10;
+	}
+	buf[len++] = '0' + x % 10;
+	buf[len] = '\0';
+	return len;
+}
+
+/**
+ * enterString() allows the user to fill the
+ * output buffer with a string of characters
+ * ending with a null terminator. Characters past
+ * the end of the buffer are read but discarded
+ */
+void enterString(struct gameContext *game) {
+	int i = 0;
+	unsigned char c = readKey();
+	while (c != '\n') {
+		if (i < bufLen - 1) {
+			game->outputBuffer[i] = c;
+			i++;
+		}
+		c = readKey();
+	}
+	game->outputBuffer[i] = '\0';
+}
+
+/**
+ * checkIndex() returns 0 if the given
+ * index is within the bounds of the game
+ * board, and 1 otherwise
+ */
+int checkIndex(int x, int y) {
+    if (x >= 1 && x <= boardWidth &&
+        y >= 1 && y <= boardHeight) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * computeParity takes a character,
+ * looks up its parity, and returns
+ * it as an unsigned char
+ */
+unsigned char computeParity(char character) {
+	return parityTable[(unsigned char) character];
+}
+
+/**
+ * createByte is a utility function that takes
+ * an index and returns a row word that is zero
+ * everywhere besides that index
+ */
+rowWord createByte(int x) {
+	rowWord c = 1;
+	return c << (boardWidth - x);
+}
+
+/**
+ * pumpLink() hands bytes from the transmit queue to the
+ * data link backend, at most LINK_TX_WINDOW at a time,
+ * until the queue is empty or the backend is busy
+ */
+void pumpLink() {
+	unsigned int start;
+	unsigned int count;
+	int taken;
+	while (txHead != txTail) {
+		start = txTail % TX_RING_SIZE;
+		count = txHead - txTail;
+		if (count > TX_RING_SIZE - start) {
+			count = TX_RING_SIZE - start;
+		}
+		if (count > LINK_TX_WINDOW) {
+			count = LINK_TX_WINDOW;
+		}
+		taken = halLinkWrite(txRing + start, count);
+		if (taken == 0) {
+			return;
+		}
+		txTail += taken;
+	}
+}
+
+/**
+ * sendLinkByte() queues one coded byte for the data link,
+ * draining the queue first if it is full (or hands the
+ * byte to the context's linkSend hook)
+ */
+void sendLinkByte(struct gameContext *game, unsigned char sent) {
+	if (game->linkSend) {
+		game->linkSend(game, sent);
+		return;
+	}
+	while (txHead - txTail == TX_RING_SIZE) {
+		pumpLink();
+	}
+	txRing[txHead % TX_RING_SIZE] = sent;
+	txHead++;
+}
+
+/**
+ * messageSent() returns 1 once the last frame sent
+ * for the game has left the transmit queue
+ */
+int messageSent(struct gameContext *game) {
+	return game->linkSend || (int) (txTail - game->txTicket) >= 0;
+}
+
+/**
+ * flushLink() waits until the last frame sent for
+ * the game is all the way across the data link
+ */
+void flushLink(struct gameContext *game) {
+	while (!messageSent(game) || halLinkBusy()) {
+		pumpLink();
+	}
+}
+
+/**
+ * sendChar sends a single character across
+ * the data link between the two FPGA boards,
+ * with its parity bit appended, or in SECDED
+ * mode as the codes of its two nibbles
+ */
+void sendChar(struct gameContext *game, char c) {
+	unsigned char sent;
+	unsigned char parity;
+	LOG_DEBUG("currently sending %c\n", c);
+	BENCH_START(start);
+	PROBE_START(cycles);
+	if (linkCode == LINK_SECDED) {
+		sendLinkByte(game, secdedCodes[(c >> 4) & 0x7]);
+		sendLinkByte(game, secdedCodes[c & 0xF]);
+		PROBE_STOP(PROBE_SEND, cycles, 2);
+		BENCH_STOP(PHASE_SEND, start);
+		return;
+	}
+	sent = c;
+	parity = sent;
+	parity = computeParity(parity);
+	sent <<= 1;
+	sent = parity + sent;
+	sendLinkByte(game, sent);
+	PROBE_STOP(PROBE_SEND, cycles, 1);
+	BENCH_STOP(PHASE_SEND, start);
+}
+
+/**
+ * checkLinkByte() strips the parity bit off a byte taken
+ * off the data link and returns the character, or the raw
+ * byte with RX_PARITY_ERROR if the parity bit was wrong
+ */
+unsigned short checkLinkByte(unsigned char frame) {
+	unsigned char received = frame >> 1;
+	if (computeParity(received) != (frame & 1)) {
+		PROBE_PARITY_ERROR();
+		return frame | RX_PARITY_ERROR;
+	}
+	return received;
+}
+
+/**
+ * decodeSecded() returns the nibble in an extended
+ * Hamming(8,4) code, correcting a single flipped bit,
+ * or RX_PARITY_ERROR if two bits were flipped. Bit 0
+ * of the code is the overall parity and bits 1 to 7
+ * are the Hamming positions, data in 3, 5, 6 and 7
+ */
+unsigned short decodeSecded(unsigned char code) {
+	unsigned char entry = secdedTable[code];
+	if (entry & SECDED_CORRECTED) {
+		PROBE_CORRECTED();
+	}
+	if (entry & SECDED_SPOILED) {
+		return RX_PARITY_ERROR;
+	}
+	return entry & 0xF;
+}
+
+/**
+ * decodeLinkByte() turns a byte taken off the data link
+ * into a character as checkLinkByte() does. In SECDED mode
+ * the first byte of each pair only returns RX_PENDING, and
+ * the second returns the character with any single-bit
+ * errors corrected, or RX_PARITY_ERROR if either half had two
+ */
+unsigned short decodeLinkByte(struct linkDecoder *decoder, unsigned char frame) {
+	unsigned short nibble;
+	if (linkCode != LINK_SECDED) {
+		return checkLinkByte(frame);
+	}
+	nibble = decodeSecded(frame);
+	if (!decoder->half) {
+		decoder->half = 1;
+		decoder->high = nibble;
+		decoder->spoiled = (nibble & RX_PARITY_ERROR) != 0;
+		return RX_PENDING;
+	}
+	decoder->half = 0;
+	if (decoder->spoiled || (nibble & RX_PARITY_ERROR) || (decoder->high & 0x8)) {
+		PROBE_PARITY_ERROR();
+		return frame | RX_PARITY_ERROR;
+	}
+	return (decoder->high << 4) | nibble;
+}
+
+/**
+ * receiveChar() checks the parity bit of a byte
+ * taken off the data link and pushes it onto the
+ * receive ring. Runs from the char_recv interrupt,
+ * or from pollReceive() when there is no interrupt.
+ * If the ring is full the byte is lost, and the next
+ * one that fits carries RX_PARITY_ERROR in its place
+ */
+void receiveChar(unsigned char frame) {
+	unsigned int next;
+	unsigned short entry = decodeLinkByte(&rxDecoder, frame);
+	if (entry == RX_PENDING) {
+		return;
+	}
+	next = (rxHead + 1) % RX_RING_SIZE;
+	if (next == rxTail) {
+		rxOverrun = 1;
+		return;
+	}
+	if (rxOverrun) {
+		entry |= RX_PARITY_ERROR;
+		rxOverrun = 0;
+	}
+	rxRing[rxHead] = entry;
+	rxHead = next;
+}
+
+/**
+ * rxRingFull() returns 1 if the receive
+ * ring has no room for another byte
+ */
+int rxRingFull() {
+	return (rxHead + 1) % RX_RING_SIZE == rxTail;
+}
+
+/**
+ * initLink() empties the receive ring and
+ * prepares the data link backend
+ */
+void initLink() {
+	rxHead = 0;
+	rxTail = 0;
+	rxOverrun = 0;
+	txHead = 0;
+	txTail = 0;
+	rxDecoder.half = 0;
+	halLinkInit();
+}
+
+/**
+ * pollReceive() keeps the transmit queue draining and moves
+ * any pending bytes from the data link onto the receive ring,
+ * as many as it has room for (the rest wait in the backend).
+ * With the char_recv interrupt enabled the ISR does the latter
+ */
+void pollReceive() {
+	pumpLink();
+#ifndef CHAR_RECV_IRQ
+	int frame;
+	while (!rxRingFull() && (frame = halLinkReceive()) >= 0) {
+		receiveChar(frame);
+	}
+#endif
+}
+
+/**
+ * linkIdle() is called while waiting on the data link.
+ * It hands the CPU to linkIdleHook if one is installed,
+ * otherwise it lets the backend wait for the next byte
+ */
+void linkIdle() {
+	if (linkIdleHook) {
+		linkIdleHook();
+	} else {
+		halLinkWait();
+	}
+}
+
+/**
+ * waitReceived() waits until the receive ring holds a
+ * byte, running the tasks meanwhile, then removes and
+ * returns it (along with RX_PARITY_ERROR if its parity
+ * bit was wrong). With idles not 0 it gives up after
+ * that many idle waits and returns RX_TIMEOUT
+ */
+unsigned short waitReceived(unsigned int idles) {
+	unsigned short entry;
+	unsigned int waited = 0;
+	pollReceive();
+	while (rxHead == rxTail) {
+		if (runTasks()) {
+			continue;
+		}
+		if (idles && waited++ == idles) {
+			return RX_TIMEOUT;
+		}
+		linkIdle();
+	}
+	entry = rxRing[rxTail];
+	rxTail = (rxTail + 1) % RX_RING_SIZE;
+	PROBE_BYTES(PROBE_RECV, 1);
+	return entry;
+}
+
+/**
+ * nextReceived() blocks until the receive ring
+ * holds a byte, then removes and returns it
+ */
+unsigned short nextReceived() {
+	return waitReceived(0);
+}
+
+/**
+ * resultSunk() returns the length of the ship the
+ * given result says was sunk, or 0 if it sank none
+ */
+int resultSunk(unsigned char result) {
+	if (result >= RESULT_SUNK(SMALL_SHIP_LENGTH) && result <= RESULT_SUNK(LARGE_SHIP_LENGTH)) {
+		return result - RESULT_SUNK(0);
+	}
+	return 0;
+}
+
+/**
+ * resultHit() returns 1 if the given result is
+ * a hit, whether or not it sank a ship
+ */
+int resultHit(unsigned char result) {
+	return result == RESULT_HIT || resultSunk(result);
+}
+
+/**
+ * encodeMessage() packs a turn message into a binary
+ * payload of wireFrames 7-bit frames: the result bit,
+ * then the zero-based row and column of the shot
+ * (3 bits each on an 8x8 board, so one frame).
+ * A missing shot or result is sent as zeros, and the
+ * length of a sunk ship goes in front (see sendFrame())
+ */
+unsigned int encodeMessage(const unsigned char *buf) {
+	unsigned int packed = 0;
+	unsigned int y;
+	unsigned int x;
+	if (resultHit(buf[0])) {
+		packed = 1U << (rowBits + columnBits);
+	}
+	if (buf[0] != '\0' && parseCoordinate(buf + 1, &y, &x) > 0 && y > 0 && x > 0) {
+		packed |= (y - 1) << columnBits;
+		packed |= x - 1;
+	}
+	return packed;
+}
+
+/**
+ * decodeMessage() unpacks a binary payload back into
+ * the ASCII turn message (e.g. "1C4") in the input buffer,
+ * turning a hit into a sinking if a FRAME_SUNK marker
+ * came in front of it
+ */
+void decodeMessage(struct gameContext *game, unsigned int packed) {
+	unsigned int y = (packed >> columnBits) & ((1U << rowBits) - 1);
+	unsigned int x = packed & ((1U << columnBits) - 1);
+	game->inputBuffer[0] = RESULT_MISS;
+	if ((packed >> (rowBits + columnBits)) & 1) {
+		game->inputBuffer[0] = game->rxSunk ? RESULT_SUNK(game->rxSunk) : RESULT_HIT;
+	}
+	formatCoordinate(y + 1, x + 1, game->inputBuffer + 1);
+}
+
+/**
+ * isControlFrame() returns 1 if the given frame is
+ * a one-character FRAME_NAK or FRAME_SYN control frame
+ */
+int isControlFrame(const unsigned char *buf) {
+	return (buf[0] == FRAME_NAK || buf[0] == FRAME_SYN) && buf[1] == '\0';
+}
+
+/**
+ * sendFrame() sends the null-terminated frame in
+ * buf, never sending more than bufLen bytes. In binary
+ * wire mode the frame goes out as wireFrames packed bytes,
+ * behind a FRAME_SUNK marker if its result sank a ship.
+ * The frame is queued and starts on its way at once
+ */
+void sendFrame(struct gameContext *game, const unsigned char *buf) {
+	int i;
+	unsigned int packed;
+	unsigned char unit;
+	if (wireMode == WIRE_BINARY) {
+		if (isControlFrame(buf)) {
+			sendChar(game, WIRE_ESCAPE);
+			sendChar(game, buf[0]);
+		} else {
+			if (resultSunk(buf[0])) {
+				sendChar(game, WIRE_ESCAPE);
+				sendChar(game, FRAME_SUNK + resultSunk(buf[0]));
+			}
+			packed = encodeMessage(buf);
+			for (i = wireFrames - 1; i >= 0; i--) {
+				unit = (packed >> (7 * i)) & 0x7F;
+				if (unit == WIRE_ESCAPE) {
+					sendChar(game, WIRE_ESCAPE);
+				}
+				sendChar(game, unit);
+			}
+		}
+	} else {
+		for (i = 0; i < bufLen - 1 && buf[i] != '\0'; i++) {
+			sendChar(game, buf[i]);
+		}
+		sendChar(game, '\0');
+	}
+	game->txTicket = txHead;
+	pumpLink();
+}
+
+/**
+ * isMarker() returns 1 if the given character is the
+ * FRAME_SEQ marker that numbers a data frame
+ */
+int isMarker(unsigned short received) {
+	return received >= FRAME_SEQ && received < FRAME_SEQ + FRAME_SEQUENCES;
+}
+
+/**
+ * isSunkMarker() returns 1 if the given character, received
+ * behind WIRE_ESCAPE, is the FRAME_SUNK marker of a sinking
+ */
+int isSunkMarker(unsigned short received) {
+	return received >= FRAME_SUNK + SMALL_SHIP_LENGTH && received <= FRAME_SUNK + LARGE_SHIP_LENGTH;
+}
+
+/**
+ * sendMarker() sends the FRAME_SEQ marker that puts
+ * the given sequence number on the next data frame
+ */
+void sendMarker(struct gameContext *game, unsigned char seq) {
+	if (wireMode == WIRE_BINARY) {
+		sendChar(game, WIRE_ESCAPE);
+	}
+	sendChar(game, FRAME_SEQ + seq);
+}
+
+/**
+ * sendControl() sends a one-character control
+ * frame (FRAME_NAK or FRAME_SYN)
+ */
+void sendControl(struct gameContext *game, unsigned char control) {
+	unsigned char frame[2];
+	frame[0] = control;
+	frame[1] = '\0';
+	sendFrame(game, frame);
+}
+
+/**
+ * replayFrames() answers a NAK by sending FRAME_SYN
+ * followed by every frame sent since the last frame
+ * received from the other player
+ */
+void replayFrames(struct gameContext *game) {
+	int i;
+	LOG_INFO("Other player dropped a frame, resending %x\n", game->sentFrameCount);
+	sendControl(game, FRAME_SYN);
+	for (i = 0; i < game->sentFrameCount; i++) {
+		sendMarker(game, game->sentSeqs[i]);
+		sendFrame(game, game->sentFrames[i]);
+	}
+}
+
+/**
+ * feedFrame() adds one received character (as returned by
+ * checkLinkByte()) to the frame being assembled in the input
+ * buffer. Returns FRAME_PENDING until the frame is complete,
+ * then FRAME_OK or the error that spoiled it. On a bad byte
+ * or a frame that does not fit in the buffer, the rest of an
+ * ASCII frame is discarded up to its terminator so the stream
+ * resyncs on the next frame. In binary wire mode the frame is
+ * wireFrames packed units, and control frames arrive behind
+ * WIRE_ESCAPE, as does the FRAME_SUNK marker of a sinking;
+ * any other byte behind it spoils the frame. A FRAME_SEQ
+ * marker in front of a frame is kept in frameMarker once the
+ * frame is complete
+ */
+int feedFrame(struct gameContext *game, unsigned short received) {
+	int status;
+	if (wireMode == WIRE_BINARY) {
+		if (!game->rxEscape && received == WIRE_ESCAPE) {
+			game->rxEscape = 1;
+			return FRAME_PENDING;
+		}
+		if (game->rxEscape && game->rxIndex == 0 &&
+				!(received & RX_PARITY_ERROR) && received != WIRE_ESCAPE) {
+			game->rxEscape = 0;
+			if (isMarker(received)) {
+				game->rxMarker = received;
+				return FRAME_PENDING;
+			}
+			if (isSunkMarker(received)) {
+				game->rxSunk = received - FRAME_SUNK;
+				return FRAME_PENDING;
+			}
+			game->rxMarker = 0;
+			game->rxSunk = 0;
+			game->frameMarker = 0;
+			if (received != FRAME_NAK && received != FRAME_SYN) {
+				LOG_ERROR("Error: Received escaped byte %x which is not a control frame\n", received);
+				game->inputBuffer[0] = '\0';
+				return FRAME_PARITY;
+			}
+			game->inputBuffer[0] = received;
+			game->inputBuffer[1] = '\0';
+			return FRAME_OK;
+		}
+		game->rxEscape = 0;
+		if (received & RX_PARITY_ERROR) {
+			LOG_ERROR("Error: Received byte \"%c\" which has incorrect parity bit\n", received & 0xFF);
+			game->inputBuffer[0] = '\0';
+			game->rxIndex = 0;
+			game->rxPacked = 0;
+			game->rxMarker = 0;
+			game->rxSunk = 0;
+			game->frameMarker = 0;
+			return FRAME_PARITY;
+		}
+		game->rxPacked = (game->rxPacked << 7) | received;
+		if (++game->rxIndex < wireFrames) {
+			return FRAME_PENDING;
+		}
+		decodeMessage(game, game->rxPacked);
+		game->rxIndex = 0;
+		game->rxPacked = 0;
+		game->rxSunk = 0;
+		game->frameMarker = game->rxMarker;
+		game->rxMarker = 0;
+		return FRAME_OK;
+	}
+	if (game->rxStatus != FRAME_OK) {
+		// Skipping the rest of a spoiled frame
+	} else if (received & RX_PARITY_ERROR) {
+		LOG_ERROR("Error: Received byte \"%c\" which has incorrect parity bit\n", received & 0xFF);
+		game->rxStatus = FRAME_PARITY;
+	} else if (game->rxIndex == 0 && isMarker(received)) {
+		game->rxMarker = received;
+	} else if (game->rxIndex == bufLen - 1 && received != '\0') {
+		LOG_ERROR("Error: Received frame longer than %x bytes\n", bufLen - 1);
+		game->rxStatus = FRAME_OVERFLOW;
+	} else {
+		game->inputBuffer[game->rxIndex++] = received;
+	}
+	if (received != '\0') {
+		return FRAME_PENDING;
+	}
+	status = game->rxStatus;
+	if (status != FRAME_OK) {
+		game->inputBuffer[0] = '\0';
+	}
+	game->rxIndex = 0;
+	game->rxStatus = FRAME_OK;
+	game->frameMarker = game->rxMarker;
+	game->rxMarker = 0;
+	return status;
+}
+
+/**
+ * frameStarted() returns 1 if part of a
+ * frame has been received but not its end
+ */
+int frameStarted(struct gameContext *game) {
+	return game->rxIndex || game->rxStatus != FRAME_OK || game->rxEscape || game->rxMarker || game->rxSunk;
+}
+
+/**
+ * dropFrame() throws away the part of a frame received so
+ * far, whose end was spoiled into something else on the way
+ */
+void dropFrame(struct gameContext *game) {
+	game->inputBuffer[0] = '\0';
+	game->rxIndex = 0;
+	game->rxStatus = FRAME_OK;
+	game->rxEscape = 0;
+	game->rxMarker = 0;
+	game->rxSunk = 0;
+	game->rxPacked = 0;
+}
+
+/**
+ * receiveFrame() reads one frame from the data link
+ * into the input buffer and returns FRAME_OK or the
+ * error the frame was dropped for. It returns
+ * FRAME_TIMEOUT if a replay we asked for, or the rest
+ * of a frame, has not come after LINK_RETRY_US
+ */
+int receiveFrame(struct gameContext *game) {
+	unsigned short received;
+	int status;
+	do {
+		if (game->awaitingReplay || frameStarted(game)) {
+			received = waitReceived(LINK_RETRY_IDLES);
+			if (received == RX_TIMEOUT) {
+				dropFrame(game);
+				return FRAME_TIMEOUT;
+			}
+		} else {
+			received = nextReceived();
+		}
+		status = feedFrame(game, received);
+	} while (status == FRAME_PENDING);
+	return status;
+}
+
+/**
+ * requestReplay() NAKs the frame just lost, unless a
+ * replay has been asked for already: that one brings
+ * the frame as well, and if it does not come either the
+ * timeout asks again, so noise on a replay in flight adds
+ * no replays of its own
+ */
+void requestReplay(struct gameContext *game) {
+	if (!game->awaitingReplay) {
+		game->awaitingReplay = 1;
+		sendControl(game, FRAME_NAK);
+	}
+}
+
+/**
+ * acceptFrame() handles a complete frame (or the error it was
+ * dropped for): a dropped frame is NAKed (see requestReplay()),
+ * and so is a timeout, a NAK is answered with a replay, and of
+ * the numbered data frames only the one with the next sequence
+ * number is taken. Up to FRAME_HISTORY frames before it are
+ * repeats from a replay and are skipped; one further on means
+ * the frame we wait for was lost, and is NAKed. In parity mode
+ * an unnumbered frame is fresh, and taken unless we are waiting
+ * for a replay; SECDED numbers every frame, so there it is junk
+ * and NAKed. Returns 1 if the input buffer now holds the next
+ * turn message
+ */
+int acceptFrame(struct gameContext *game, int status) {
+	unsigned int behind;
+	if (status == FRAME_TIMEOUT) {
+		LOG_INFO("Other player has gone quiet, sending another NAK\n");
+		game->awaitingReplay = 1;
+		sendControl(game, FRAME_NAK);
+	} else if (status != FRAME_OK) {
+		requestReplay(game);
+	} else if (isControlFrame(game->inputBuffer) && game->inputBuffer[0] == FRAME_NAK) {
+		replayFrames(game);
+	} else if (isControlFrame(game->inputBuffer)) {
+		game->awaitingReplay = 0;
+	} else if (game->frameMarker ? game->frameMarker == FRAME_SEQ + game->rxSeq : linkCode != LINK_SECDED && !game->awaitingReplay) {
+		game->rxSeq = (game->rxSeq + 1) % FRAME_SEQUENCES;
+		game->awaitingReplay = 0;
+		game->sentFrameCount = 0;
+		return 1;
+	} else {
+		behind = (game->rxSeq + FRAME_SEQUENCES - (game->frameMarker - FRAME_SEQ)) % FRAME_SEQUENCES;
+		if (!game->frameMarker || behind > FRAME_HISTORY) {
+			requestReplay(game);
+		}
+	}
+	return 0;
+}
+
+/**
+ * readString() reads a null-terminated
+ * string of characters being sent from
+ * the other player's FPGA board and
+ * stores it to the input buffer. Dropped
+ * frames are NAKed and replayed by the sender,
+ * and the number of frames dropped is returned
+ */
+int readString(struct gameContext *game) {
+	int dropped = 0;
+	int status;
+	BENCH_START(start);
+	PROBE_START(cycles);
+	do {
+		status = receiveFrame(game);
+		dropped += status != FRAME_OK && status != FRAME_TIMEOUT;
+	} while (!acceptFrame(game, status));
+	PROBE_STOP(PROBE_RECV, cycles, 0);
+	BENCH_STOP(PHASE_RECV, start);
+	return dropped;
+}
+
+/**
+ * lingerLink() keeps answering NAKs after the final message
+ * of a game until the link has been quiet for LINK_RETRY_LIMIT
+ * retry intervals (or the other player has hung up), so a final
+ * frame spoiled on the way is replayed before this side stops
+ * listening, even if a repeated NAK is lost as well
+ */
+void lingerLink(struct gameContext *game) {
+	unsigned int idles = 0;
+	int status;
+	while (idles++ < LINK_RETRY_IDLES * LINK_RETRY_LIMIT) {
+		pollReceive();
+		while (rxHead != rxTail) {
+			status = feedFrame(game, nextReceived());
+			if (status != FRAME_PENDING) {
+				acceptFrame(game, status);
+			}
+			idles = 0;
+		}
+		if (!halLinkOpen()) {
+			return;
+		}
+		linkIdle();
+	}
+}
+
+/**
+ * sendString() sends the null-terminated
+ * string that is contained within the
+ * output buffer, and keeps a copy of it
+ * in case the other player asks for a replay
+ */
+void sendString(struct gameContext *game) {
+	int i;
+	if (game->sentFrameCount == FRAME_HISTORY) {
+		for (i = 1; i < FRAME_HISTORY; i++) {
+			memcpy(game->sentFrames[i - 1], game->sentFrames[i], bufLen);
+			game->sentSeqs[i - 1] = game->sentSeqs[i];
+		}
+		game->sentFrameCount--;
+	}
+	memcpy(game->sentFrames[game->sentFrameCount], game->outputBuffer, bufLen);
+	game->sentFrames[game->sentFrameCount][bufLen - 1] = '\0';
+	game->sentSeqs[game->sentFrameCount] = game->txSeq;
+	game->sentFrameCount++;
+	if (linkCode == LINK_SECDED) {
+		sendMarker(game, game->txSeq);
+	}
+	game->txSeq = (game->txSeq + 1) % FRAME_SEQUENCES;
+	sendFrame(game, game->outputBuffer);
+}
+
+/**
+ * prinInput() prints the null-terminated
+ * string contained within the input buffer
+ */
+void printInput(struct gameContext *game) {
+	int i = 0;
+	while (game->inputBuffer[i] != '\0') {
+		conPutchar(game->inputBuffer[i]);
+		i++;
+	}
+	conPutchar('\n');
+}
+
+/**
+ * packRows() serialises count cached rows starting at
+ * row index first into buf, rowBytes bytes per row with
+ * the most significant byte first
+ */
+void packRows(struct gameContext *game, int first, int count, unsigned char *buf) {
+	int i;
+	int j;
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < rowBytes; j++) {
+			*buf++ = game->boards[first + i] >> (8 * (rowBytes - 1 - j));
+		}
+	}
+}
+
+/**
+ * loadBoardCache() fills the board cache with
+ * the current contents of the three game boards
+ * in SRAM (or clears it for a context not backed
+ * by the SRAM) and marks every row as clean
+ */
+void loadBoardCache(struct gameContext *game) {
+	unsigned char buf[MAX_BOARD_WIDTH / 8];
+	int i;
+	int j;
+	memset(game->boardDirty, 0, sizeof(game->boardDirty));
+	if (!game->sram) {
+		memset(game->boards, 0, boardRows * sizeof(rowWord));
+		return;
+	}
+	for (i = 0; i < boardRows; i++) {
+		readSRAMBlock(i * rowBytes, buf, rowBytes);
+		game->boards[i] = 0;
+		for (j = 0; j < rowBytes; j++) {
+			game->boards[i] = (game->boards[i] << 8) | buf[j];
+		}
+	}
+}
+
+/**
+ * readBoard() returns the row of a game board
+ * at the given row index, served from the
+ * board cache instead of the SRAM itself
+ */
+rowWord readBoard(struct gameContext *game, int addr) {
+	return game->boards[addr];
+}
+
+/**
+ * readBoardBlock() copies len consecutive rows
+ * starting at the given row index out of
+ * the board cache into buf
+ */
+void readBoardBlock(struct gameContext *game, int addr, rowWord *buf, int len) {
+	memcpy(buf, game->boards + addr, len * sizeof(rowWord));
+}
+
+/**
+ * writeBoard() stores the given row of a game
+ * board in the board cache and marks it dirty.
+ * The row only reaches SRAM on the next syncBoards(),
+ * or on the write-back queued for the SRAM task, whose
+ * scan is taken back to the row if it is already past it
+ */
+void writeBoard(struct gameContext *game, int addr, rowWord row) {
+	if (game->boards[addr] != row) {
+		game->boards[addr] = row;
+		game->boardDirty[addr / ROW_WORD_BITS] |= 1ULL << (addr % ROW_WORD_BITS);
+		if (game == syncGame && addr < syncRow) {
+			syncRow = addr;
+		}
+	}
+}
+
+/**
+ * isRowDirty() returns nonzero if the cached
+ * row at the given index has not been synced
+ */
+int isRowDirty(struct gameContext *game, int addr) {
+	return (game->boardDirty[addr / ROW_WORD_BITS] >> (addr % ROW_WORD_BITS)) & 1;
+}
+
+/**
+ * logEvent() adds an event to the game's event log. It only
+ * goes into the context's buffer, so logging costs the same
+ * every turn; syncBoards() writes the buffer out. Events past
+ * the buffer are dropped
+ */
+void logEvent(struct gameContext *game, unsigned int type, unsigned int flags, unsigned int a, unsigned int b) {
+	unsigned char *event;
+	if (game->logPending == LOG_PENDING) {
+		return;
+	}
+	event = game->logBuffer + game->logPending++ * LOG_EVENT_SIZE;
+	event[0] = (type << 5) | flags;
+	event[1] = a;
+	event[2] = b;
+}
+
+/**
+ * flushLog() appends the buffered events to the log
+ * in SRAM, followed by the end marker that the next
+ * flush writes over, and to the host log file. Once the
+ * SRAM is full the rest of the game is only kept in
+ * the file
+ */
+void flushLog(struct gameContext *game) {
+	static const unsigned char end[LOG_EVENT_SIZE] = {0};
+	unsigned int length = game->logPending * LOG_EVENT_SIZE;
+	if (length == 0) {
+		return;
+	}
+	if (game->sram && LOG_BASE + game->logLength + length + LOG_EVENT_SIZE <= LOG_LIMIT) {
+		writeSRAMBlock(LOG_BASE + game->logLength, game->logBuffer, length);
+		writeSRAMBlock(LOG_BASE + game->logLength + length, end, LOG_EVENT_SIZE);
+		game->logLength += length;
+	}
+#ifdef HOST_SIM
+	if (game->sram && hostLogFile) {
+		fwrite(game->logBuffer, 1, length, hostLogFile);
+	}
+#endif
+	game->logPending = 0;
+}
+
+/**
+ * stateChecksum() returns the Fletcher-16 checksum of a
+ * resume state (up to its checksum field) and the boards
+ */
+unsigned int stateChecksum(struct gameContext *game, const unsigned char *state) {
+	unsigned int a = 0;
+	unsigned int b = 0;
+	int i;
+	int j;
+	// The sums are reduced once per row, long before they could overflow
+	for (i = 0; i < RESUME_SIZE - 2; i++) {
+		a += state[i];
+		b += a;
+	}
+	for (i = 0; i < boardRows; i++) {
+		a %= 255;
+		b %= 255;
+		for (j = 0; j < rowBytes * 8; j += 8) {
+			a += (game->boards[i] >> j) & 0xFF;
+			b += a;
+		}
+	}
+	return ((b % 255) << 8) | (a % 255);
+}
+
+/**
+ * saveState() writes the resume state of a game in
+ * progress to the SRAM, to go with the boards just synced
+ */
+void saveState(struct gameContext *game) {
+	unsigned char state[RESUME_SIZE];
+	unsigned int checksum;
+	int last = game->sentFrameCount - 1;
+	int i;
+	if (!game->sram || game->player == 0) {
+		return;
+	}
+	memset(state, 0, sizeof(state));
+	state[0] = RESUME_MAGIC;
+	state[1] = boardWidth;
+	state[2] = boardHeight;
+	state[3] = game->player;
+	state[4] = game->yourTurn;
+	state[5] = game->yourHits;
+	state[6] = game->enemyHits;
+	state[7] = game->pendingResult;
+	state[8] = game->yourShotX;
+	state[9] = game->yourShotY;
+	state[10] = game->txSeq;
+	state[11] = game->rxSeq;
+	state[12] = game->shipCount;
+	state[15] = game->logLength >> 8;
+	state[16] = game->logLength;
+	if (last >= 0) {
+		state[13] = 1;
+		state[14] = game->sentSeqs[last];
+		memcpy(state + RESUME_FRAME, game->sentFrames[last], bufLen);
+	}
+	for (i = 0; i < game->shipCount; i++) {
+		state[RESUME_SHIPS + 4 * i] = game->fleetShips[i].x;
+		state[RESUME_SHIPS + 4 * i + 1] = game->fleetShips[i].y;
+		state[RESUME_SHIPS + 4 * i + 2] = game->fleetShips[i].length;
+		state[RESUME_SHIPS + 4 * i + 3] = game->fleetShips[i].vertical;
+	}
+	state[RESUME_SUNK] = game->ai.sunkCount;
+	for (i = 0; i < game->ai.sunkCount; i++) {
+		state[RESUME_SUNK + 1 + 4 * i] = game->ai.sunkShips[i].x;
+		state[RESUME_SUNK + 1 + 4 * i + 1] = game->ai.sunkShips[i].y;
+		state[RESUME_SUNK + 1 + 4 * i + 2] = game->ai.sunkShips[i].length;
+		state[RESUME_SUNK + 1 + 4 * i + 3] = game->ai.sunkShips[i].vertical;
+	}
+	checksum = stateChecksum(game, state);
+	state[RESUME_SIZE - 2] = checksum >> 8;
+	state[RESUME_SIZE - 1] = checksum;
+	writeSRAMBlock(RESUME_BASE, state, RESUME_SIZE);
+}
+
+/**
+ * clearState() marks the SRAM as holding no game to
+ * resume, once a game is over or a new one is set up
+ */
+void clearState(struct gameContext *game) {
+	unsigned char none = 0;
+	if (game->sram) {
+		writeSRAMBlock(RESUME_BASE, &none, 1);
+	}
+}
+
+/**
+ * syncRows() writes the first run of consecutive dirty
+ * rows at or after row index *row back to SRAM in one
+ * block transfer (at most SYNC_CHUNK_ROWS rows, for wide
+ * boards), marks them clean and moves *row past them.
+ * Returns 0 if there was no dirty row left to write
+ */
+int syncRows(struct gameContext *game, unsigned int *row) {
+	unsigned char buf[SYNC_CHUNK_ROWS * MAX_BOARD_WIDTH / 8];
+	unsigned int start = *row;
+	unsigned int end;
+	while (game->sram && start < boardRows && !isRowDirty(game, start)) {
+		start++;
+	}
+	if (!game->sram || start >= boardRows) {
+		*row = boardRows;
+		return 0;
+	}
+	end = start;
+	while (end < boardRows && end - start < SYNC_CHUNK_ROWS && isRowDirty(game, end)) {
+		game->boardDirty[end / ROW_WORD_BITS] &= ~(1ULL << (end % ROW_WORD_BITS));
+		end++;
+	}
+	packRows(game, start, end - start, buf);
+	writeSRAMBlock(start * rowBytes, buf, (end - start) * rowBytes);
+	*row = end;
+	return 1;
+}
+
+/**
+ * syncBoards() writes every dirty row of the
+ * board cache back to SRAM, then the events
+ * logged since the last call and the resume
+ * state, taking over any write-back queued
+ * for the SRAM task. Called after setting up
+ * boats and at the end of a game
+ */
+void syncBoards(struct gameContext *game) {
+	unsigned int row = 0;
+	if (syncGame == game) {
+		syncGame = 0;
+	}
+	while (syncRows(game, &row)) {
+		pumpLink();
+	}
+	flushLog(game);
+	saveState(game);
+}
+
+/**
+ * requestSync() queues what syncBoards() does for the
+ * SRAM task, which does it at the next waits, a run of
+ * rows per turn. Called at the end of each turn. If the
+ * task has not got through the last turn's sync (the
+ * reply was already waiting), that one is finished
+ * here first, so the log and the resume state are at
+ * most one turn behind and the log buffer never fills
+ */
+void requestSync(struct gameContext *game) {
+	if (syncGame) {
+		syncBoards(syncGame);
+	}
+	syncGame = game;
+	syncRow = 0;
+}
+
+/**
+ * keyboardTask() moves keystrokes from the keyboard
+ * onto the key queue as they are typed, so a shot
+ * can be typed ahead while the game is busy
+ */
+int keyboardTask(struct task *task) {
+	int count;
+	TASK_BEGIN(task);
+	for (;;) {
+		TASK_WAIT_UNTIL(task, !keyEnded && keyHead - keyTail < KEY_RING_SIZE);
+		count = KEY_RING_SIZE - keyHead % KEY_RING_SIZE;
+		if (count > (int) (KEY_RING_SIZE - (keyHead - keyTail))) {
+			count = KEY_RING_SIZE - (keyHead - keyTail);
+		}
+		count = halKeyRead(keyRing + keyHead % KEY_RING_SIZE, count);
+		if (count == 0) {
+			return TASK_WAITING;
+		}
+		if (count < 0) {
+			keyEnded = 1;
+		} else {
+			keyHead += count;
+		}
+		TASK_YIELD(task);
+	}
+	TASK_END(task);
+}
+
+/**
+ * linkTask() drains the transmit queue and collects received
+ * bytes; it keeps no state of its own between turns, so it
+ * reports work whenever either ring has moved
+ */
+int linkTask(struct task *task) {
+	unsigned int sent = txTail;
+	unsigned int received = rxHead;
+	pollReceive();
+	return txTail != sent || rxHead != received ? TASK_RAN : TASK_WAITING;
+}
+
+/**
+ * sramTask() carries out a write-back queued by
+ * requestSync(), yielding after each run of rows.
+ * A row dirtied during a yield behind the scan takes
+ * the scan back (see writeBoard()), so the scan only
+ * ends with every row written. The log and the resume
+ * state follow the last run without a yield, so no
+ * turn can dirty the boards between the rows and the
+ * checksum covering them
+ */
+int sramTask(struct task *task) {
+	TASK_BEGIN(task);
+	for (;;) {
+		TASK_WAIT_UNTIL(task, syncGame != 0);
+		while (syncGame && syncRows(syncGame, &syncRow)) {
+			TASK_YIELD(task);
+		}
+		if (syncGame) {
+			flushLog(syncGame);
+			saveState(syncGame);
+			syncGame = 0;
+		}
+	}
+	TASK_END(task);
+}
+
+/**
+ * renderTask() streams the console buffer to the
+ * console CON_CHUNK bytes per turn, so drawing the
+ * boards never holds up the link or the keyboard
+ */
+int renderTask(struct task *task) {
+	TASK_BEGIN(task);
+	for (;;) {
+		TASK_WAIT_UNTIL(task, conLength > conSent);
+		conWrite(CON_CHUNK);
+		TASK_YIELD(task);
+	}
+	TASK_END(task);
+}
+
+struct task tasks[] = {
+	{0, keyboardTask},
+	{0, linkTask},
+	{0, sramTask},
+	{0, renderTask}
+};
+
+/**
+ * runTasks() gives every task one turn, and returns
+ * 1 if any of them found something to do (the caller
+ * only idles when none did)
+ */
+int runTasks() {
+	int ran = 0;
+	unsigned int i;
+	for (i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+		ran |= tasks[i].run(&tasks[i]);
+	}
+	return ran;
+}
+
+/**
+ * boardAt() returns the bitboard (one row word per
+ * board row) that starts at the given row index
+ */
+rowWord *boardAt(struct gameContext *game, unsigned int base) {
+	return game->boards + base;
+}
+
+/**
+ * boardCount() returns the number of cells
+ * set on the given bitboard
+ */
+unsigned int boardCount(const rowWord *board) {
+	unsigned int count = 0;
+	int i;
+	for (i = 0; i < boardHeight; i++) {
+		count += __builtin_popcountll(board[i]);
+	}
+	return count;
+}
+
+/**
+ * boardEmpty() returns 1 if no cell is
+ * set on the given bitboard
+ */
+int boardEmpty(const rowWord *board) {
+	rowWord any = 0;
+	int i;
+	for (i = 0; i < boardHeight; i++) {
+		any |= board[i];
+	}
+	return any == 0;
+}
+
+/**
+ * boardTest() returns the bit of the given
+ * bitboard at the one-based coordinate (x, y)
+ */
+int boardTest(const rowWord *board, unsigned int x, unsigned int y) {
+	return (board[y - 1] >> (boardWidth - x)) & 1;
+}
+
+/**
+ * legalMoves() fills moves with the bitboard of
+ * every cell that has not been fired at yet
+ */
+void legalMoves(struct gameContext *game, rowWord *moves) {
+	const rowWord *shots = boardAt(game, shotsBase);
+	int i;
+	for (i = 0; i < boardHeight; i++) {
+		moves[i] = ~shots[i] & fullRow;
+	}
+}
+
+/**
+ * shipRowMask() returns the row word covering the columns
+ * of the given ship in any row it occupies
+ */
+rowWord shipRowMask(const struct ship *ship) {
+	if (ship->vertical) {
+		return createByte(ship->x);
+	}
+	return (((rowWord) 1 << ship->length) - 1) << (boardWidth - ship->x - ship->length + 1);
+}
+
+/**
+ * fleetRows() returns the rows of the given fleet
+ * that the given ship spans, ORed together
+ */
+rowWord fleetRows(const rowWord *fleet, const struct ship *ship) {
+	rowWord rows = 0;
+	int count = ship->vertical ? ship->length : 1;
+	int i;
+	for (i = 0; i < count; i++) {
+		rows |= fleet[ship->y - 1 + i];
+	}
+	return rows;
+}
+
+/**
+ * indexShip() records in the given fleet index (a byte per
+ * cell, row by row) that the ship with the given index
+ * covers each of its cells
+ */
+void indexShip(unsigned char *cells, const struct ship *ship, int index) {
+	int i;
+	for (i = 0; i < ship->length; i++) {
+		if (ship->vertical) {
+			cells[(ship->y - 1 + i) * boardWidth + ship->x - 1] = index;
+		} else {
+			cells[(ship->y - 1) * boardWidth + ship->x - 1 + i] = index;
+		}
+	}
+}
+
+/**
+ * indexFleet() rebuilds the fleet index of the given game
+ * from its ships, counting the cells of each one that are
+ * still on your board
+ */
+void indexFleet(struct gameContext *game) {
+	const struct ship *ship;
+	int i;
+	int j;
+	for (i = 0; i < game->shipCount; i++) {
+		ship = &game->fleetShips[i];
+		indexShip(game->shipCells, ship, i);
+		game->shipAfloat[i] = 0;
+		for (j = 0; j < (ship->vertical ? ship->length : 1); j++) {
+			game->shipAfloat[i] += __builtin_popcountll(readBoard(game, boardBase + ship->y - 1 + j) &
+					shipRowMask(ship));
+		}
+	}
+}
+
+/**
+ * freeStarts() fills starts with the bitboard of cells a ship of the
+ * given length and orientation can start at without leaving the board
+ * or touching the given fleet, and returns how many there are
+ */
+unsigned int freeStarts(const rowWord *fleet, int length, int vertical, rowWord *starts) {
+	const rowWord *legal = placeStarts[LARGE_SHIP_LENGTH - length][vertical];
+	unsigned int count = 0;
+	rowWord blocked;
+	int r;
+	int k;
+	for (r = 0; r < boardHeight; r++) {
+		blocked = 0;
+		for (k = 0; k < length; k++) {
+			if (vertical) {
+				blocked |= r + k < boardHeight ? fleet[r + k] : fullRow;
+			} else {
+				blocked |= fleet[r] << k;
+			}
+		}
+		starts[r] = legal[r] & ~blocked;
+		count += __builtin_popcountll(starts[r]);
+	}
+	return count;
+}
+
+/**
+ * placementFits() returns 1 if a ship of the given length and
+ * orientation starting at the one-based coordinate (x, y) stays
+ * on the board and clear of the given fleet
+ */
+int placementFits(const rowWord *fleet, unsigned int x, unsigned int y, int length, int vertical) {
+	struct ship ship;
+	if (checkIndex(x, y) || !boardTest(placeStarts[LARGE_SHIP_LENGTH - length][vertical], x, y)) {
+		return 0;
+	}
+	ship.x = x;
+	ship.y = y;
+	ship.length = length;
+	ship.vertical = vertical;
+	return (fleetRows(fleet, &ship) & shipRowMask(&ship)) == 0;
+}
+
+/**
+ * nextRandom() steps the given xorshift state and returns it;
+ * the engine draws from a caller-owned state rather than rand()
+ * so that games on different threads never share one
+ */
+unsigned int nextRandom(unsigned int *seed) {
+	unsigned int x = *seed ? *seed : 1;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*seed = x;
+	return x;
+}
+
+/**
+ * pickCell() sets (x, y) to the pick'th set cell
+ * (counting from zero, row by row) of the given bitboard
+ */
+void pickCell(const rowWord *cells, unsigned int pick, unsigned int *x, unsigned int *y) {
+	int r;
+	rowWord row;
+	for (r = 0; pick >= __builtin_popcountll(cells[r]); r++) {
+		pick -= __builtin_popcountll(cells[r]);
+	}
+	row = cells[r];
+	while (pick-- > 0) {
+		row &= row - 1;
+	}
+	*y = r + 1;
+	*x = boardWidth - __builtin_ctzll(row);
+}
+
+/**
+ * randomPlacement() picks a uniformly random free start for a ship
+ * of the given length over the given fleet, trying the other
+ * orientation if the chosen one has no room; returns 1 if the
+ * ship fits nowhere
+ */
+int randomPlacement(const rowWord *fleet, int length, unsigned int *seed,
+		unsigned int *x, unsigned int *y, int *vertical) {
+	rowWord starts[MAX_BOARD_HEIGHT];
+	unsigned int count;
+	int tries;
+	*vertical = nextRandom(seed) & 1;
+	for (tries = 0; tries < 2; tries++, *vertical = !*vertical) {
+		count = freeStarts(fleet, length, *vertical, starts);
+		if (count != 0) {
+			pickCell(starts, nextRandom(seed) % count, x, y);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * randomShot() sets (x, y) to a uniformly random cell that is not
+ * on the given shots board; returns 1 if every cell was fired at
+ */
+int randomShot(const rowWord *shots, unsigned int *seed, unsigned int *x, unsigned int *y) {
+	rowWord open[MAX_BOARD_HEIGHT];
+	unsigned int count = 0;
+	int r;
+	for (r = 0; r < boardHeight; r++) {
+		open[r] = ~shots[r] & fullRow;
+		count += __builtin_popcountll(open[r]);
+	}
+	if (count == 0) {
+		return 1;
+	}
+	pickCell(open, nextRandom(seed) % count, x, y);
+	return 0;
+}
+
+/**
+ * aiAdjust() adds the given amounts to the density and
+ * boost of every cell covered by the given placement
+ */
+void aiAdjust(struct aiState *ai, const struct ship *ship, int density, int boost) {
+	int i;
+	for (i = 0; i < ship->length; i++) {
+		if (ship->vertical) {
+			ai->density[(ship->y - 1 + i) * boardWidth + ship->x - 1] += density;
+			ai->boost[(ship->y - 1 + i) * boardWidth + ship->x - 1] += boost;
+		} else {
+			ai->density[(ship->y - 1) * boardWidth + ship->x - 1 + i] += density;
+			ai->boost[(ship->y - 1) * boardWidth + ship->x - 1 + i] += boost;
+		}
+	}
+}
+
+/**
+ * aiReset() counts every placement of every ship length on
+ * an empty board into the density map (copied from the
+ * constant table on the default size)
+ */
+void aiReset(struct aiState *ai) {
+	struct ship ship;
+	int length;
+	int vertical;
+	int r;
+	memset(ai->boost, 0, boardWidth * boardHeight);
+	memset(ai->sunk, 0, boardHeight * sizeof(rowWord));
+	ai->afloat = (1 << SHIP_COUNT) - 1;
+	ai->sunkCount = 0;
+	ai->hitWeight = AI_HIT_WEIGHT;
+	if (placeStarts == defaultPlaceStarts) {
+		for (r = 0; r < boardHeight; r++) {
+			memcpy(ai->density + r * boardWidth, defaultDensity[r], boardWidth);
+		}
+		return;
+	}
+	memset(ai->density, 0, boardWidth * boardHeight);
+	for (length = SMALL_SHIP_LENGTH; length <= LARGE_SHIP_LENGTH; length++) {
+		ship.length = length;
+		for (vertical = 0; vertical < 2; vertical++) {
+			ship.vertical = vertical;
+			for (ship.y = 1; ship.y <= boardHeight; ship.y++) {
+				for (ship.x = 1; ship.x <= boardWidth; ship.x++) {
+					if (boardTest(placeStarts[LARGE_SHIP_LENGTH - length][vertical], ship.x, ship.y)) {
+						aiAdjust(ai, &ship, 1, 0);
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * aiObserve() folds the result of a shot at the one-based
+ * coordinate (x, y) into the maps. Only the placements covering
+ * that cell change: on a miss the ones that were still open are
+ * removed, on a hit each of them gains one hit. shots and hits
+ * are the enemy boards, already holding this shot
+ */
+void aiObserve(struct aiState *ai, const rowWord *shots, const rowWord *hits,
+		unsigned int x, unsigned int y, int hit) {
+	struct ship ship;
+	rowWord mask;
+	rowWord missed;
+	int length;
+	int vertical;
+	int k;
+	int i;
+	for (length = SMALL_SHIP_LENGTH; length <= LARGE_SHIP_LENGTH; length++) {
+		if (!(ai->afloat & (1 << (LARGE_SHIP_LENGTH - length)))) {
+			continue;
+		}
+		ship.length = length;
+		for (vertical = 0; vertical < 2; vertical++) {
+			ship.vertical = vertical;
+			for (k = 0; k < length; k++) {
+				ship.x = vertical ? x : x - k;
+				ship.y = vertical ? y - k : y;
+				if (checkIndex(ship.x, ship.y) ||
+						!boardTest(placeStarts[LARGE_SHIP_LENGTH - length][vertical], ship.x, ship.y)) {
+					continue;
+				}
+				// A placement is still open if none of its other cells is a miss
+				// or part of a sunk ship
+				mask = shipRowMask(&ship);
+				missed = 0;
+				for (i = 0; i < (vertical ? length : 1); i++) {
+					missed |= (shots[ship.y - 1 + i] & ~hits[ship.y - 1 + i] &
+							~(ship.y + i == y ? createByte(x) : 0)) | ai->sunk[ship.y - 1 + i];
+				}
+				if (missed & mask) {
+					continue;
+				}
+				if (hit) {
+					aiAdjust(ai, &ship, 0, 1);
+				} else {
+					aiAdjust(ai, &ship, -1, -(int) __builtin_popcountll(fleetRows(hits, &ship) & mask));
+				}
+			}
+		}
+	}
+}
+
+/**
+ * aiRebuild() recounts both maps from scratch over the
+ * placements of the ships still afloat that cross neither
+ * a miss nor a sunk ship
+ */
+void aiRebuild(struct aiState *ai, const rowWord *shots, const rowWord *hits) {
+	struct ship ship;
+	rowWord mask;
+	rowWord blocked;
+	int covered;
+	int length;
+	int vertical;
+	int i;
+	memset(ai->density, 0, boardWidth * boardHeight);
+	memset(ai->boost, 0, boardWidth * boardHeight);
+	for (length = SMALL_SHIP_LENGTH; length <= LARGE_SHIP_LENGTH; length++) {
+		if (!(ai->afloat & (1 << (LARGE_SHIP_LENGTH - length)))) {
+			continue;
+		}
+		ship.length = length;
+		for (vertical = 0; vertical < 2; vertical++) {
+			ship.vertical = vertical;
+			for (ship.y = 1; ship.y <= boardHeight; ship.y++) {
+				for (ship.x = 1; ship.x <= boardWidth; ship.x++) {
+					if (!boardTest(placeStarts[LARGE_SHIP_LENGTH - length][vertical], ship.x, ship.y)) {
+						continue;
+					}
+					mask = shipRowMask(&ship);
+					blocked = 0;
+					covered = 0;
+					for (i = 0; i < (vertical ? length : 1); i++) {
+						blocked |= (shots[ship.y - 1 + i] & ~hits[ship.y - 1 + i]) | ai->sunk[ship.y - 1 + i];
+						covered += __builtin_popcountll(hits[ship.y - 1 + i] & mask);
+					}
+					if (!(blocked & mask)) {
+						aiAdjust(ai, &ship, 1, covered);
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * aiMarkSunk() takes the length of the given sunk ship out of
+ * play and, if its cells are known, marks them on the sunk board
+ */
+void aiMarkSunk(struct aiState *ai, const struct ship *ship) {
+	int i;
+	ai->afloat &= ~(1 << (LARGE_SHIP_LENGTH - ship->length));
+	ai->sunkShips[ai->sunkCount++] = *ship;
+	for (i = 0; ship->x != 0 && i < (ship->vertical ? ship->length : 1); i++) {
+		ai->sunk[ship->y - 1 + i] |= shipRowMask(ship);
+	}
+}
+
+/**
+ * aiSink() folds the news that the shot at the one-based
+ * coordinate (x, y) sank a ship of the given length into the
+ * maps. The ship is the one placement of that length through
+ * (x, y) made up of hits alone, if only one is; either way the
+ * length is out of play and the maps are rebuilt. shots and
+ * hits are the enemy boards, already holding this shot
+ */
+void aiSink(struct aiState *ai, const rowWord *shots, const rowWord *hits,
+		unsigned int x, unsigned int y, int length) {
+	struct ship ship;
+	struct ship found;
+	rowWord unhit;
+	int candidates = 0;
+	int vertical;
+	int k;
+	int i;
+	if (!(ai->afloat & (1 << (LARGE_SHIP_LENGTH - length)))) {
+		return;
+	}
+	ship.length = length;
+	for (vertical = 0; vertical < 2; vertical++) {
+		ship.vertical = vertical;
+		for (k = 0; k < length; k++) {
+			ship.x = vertical ? x : x - k;
+			ship.y = vertical ? y - k : y;
+			if (checkIndex(ship.x, ship.y) ||
+					!boardTest(placeStarts[LARGE_SHIP_LENGTH - length][vertical], ship.x, ship.y)) {
+				continue;
+			}
+			unhit = 0;
+			for (i = 0; i < (vertical ? length : 1); i++) {
+				unhit |= ~hits[ship.y - 1 + i] | ai->sunk[ship.y - 1 + i];
+			}
+			if (!(unhit & shipRowMask(&ship))) {
+				found = ship;
+				candidates++;
+			}
+		}
+	}
+	if (candidates != 1) {
+		found.x = 0;
+		found.y = 0;
+		found.vertical = 0;
+	}
+	found.length = length;
+	aiMarkSunk(ai, &found);
+	aiRebuild(ai, shots, hits);
+}
+
+/**
+ * aiChooseShot() sets (x, y) to the unfired cell with the highest
+ * score, weighting placements next to a hit by the hit weight
+ * and breaking ties at random. Returns 1 if every cell was fired at
+ */
+int aiChooseShot(struct aiState *ai, const rowWord *shots, unsigned int *x, unsigned int *y) {
+	unsigned int best = 0;
+	unsigned int ties = 0;
+	unsigned int score;
+	unsigned int c;
+	int r;
+	rowWord open;
+	for (r = 0; r < boardHeight; r++) {
+		open = ~shots[r] & fullRow;
+		while (open) {
+			c = boardWidth - __builtin_ctzll(open);
+			open &= open - 1;
+			score = ai->density[r * boardWidth + c - 1] + ai->hitWeight * ai->boost[r * boardWidth + c - 1];
+			if (ties == 0 || score > best) {
+				best = score;
+				ties = 0;
+			} else if (score < best) {
+				continue;
+			}
+			if (nextRandom(&ai->seed) % ++ties == 0) {
+				*x = c;
+				*y = r + 1;
+			}
+		}
+	}
+	return ties == 0;
+}
+
+/**
+ * checkMove() checks the given board
+ * to see if the given index is set high already
+ * and returns 1 if it is set high.
+ */
+int checkMove(struct gameContext *game, unsigned int x, unsigned int y, unsigned int boardAddr) {
+	return boardTest(boardAt(game, boardAddr), x, y);
+}
+
+/**
+ * translateOutputBuffer() reads the current
+ * two-character index that is stored in the output
+ * buffer, converts it from the traditional
+ * Battleship index notation (e.g. 'A1' or 'C7') to
+ * normal integers (handier when in the program for shifting
+ * bytes or working with SRAM)
+ */
+void translateOutputBuffer(struct gameContext *game) {
+	int len = parseCoordinate(game->outputBuffer, &game->yourShotY, &game->yourShotX);
+	if (game->outputBuffer[len] != '\0') {
+		game->yourShotY = 0;
+		game->yourShotX = 0;
+	}
+}
+
+/**
+ * translateInputBuffer() serves the same function as
+ * translateOutputBuffer(), except for the input buffer,
+ * where the shot follows the one-character result
+ */
+void translateInputBuffer(struct gameContext *game) {
+	parseCoordinate(game->inputBuffer + 1, &game->theirShotY, &game->theirShotX);
+}
+
+/**
+ * prependResult() inserts the pending result for
+ * the other player's last shot in front of the shot
+ * held in the output buffer, so both go out in one message
+ */
+void prependResult(struct gameContext *game) {
+	int i;
+	for (i = bufLen - 2; i > 0; i--) {
+		game->outputBuffer[i] = game->outputBuffer[i - 1];
+	}
+	game->outputBuffer[bufLen - 1] = '\0';
+	game->outputBuffer[0] = game->pendingResult;
+}
+
+/**
+ * updateEnemyBoard() stores a new state of one
+ * of the enemy game boards in SRAM. Which game board
+ * (shots you have made on their board, or hits you
+ * have made on their board) is determined by the base
+ * address passed to the function. The update that
+ * is made is based the value of the context fields
+ * yourShotX and yourShotY; the index indicated by
+ * those values will be set high in the board that is passed
+ */
+void updateEnemyBoard(struct gameContext *game, int board) {
+	rowWord row;
+	row = readBoard(game, game->yourShotY - 1 + board);
+	LOG_DEBUG("Current values at row %x: %x\n", game->yourShotY, (unsigned int) row);
+	rowWord newRow;
+	newRow = row | createByte(game->yourShotX);
+	LOG_DEBUG("Inserting at row %x: %x\n", game->yourShotY, (unsigned int) newRow);
+	writeBoard(game, game->yourShotY - 1 + board, newRow);
+}
+
+/**
+ * updateYourBoard() uses the context fields theirShotX and
+ * theirShotY to update your game board. The function determines
+ * whether the enemy's shot was a hit or miss, indicates this on the
+ * console, and updates your game board and boat count. The fleet
+ * index tells which ship was hit, so a sinking is spotted at once.
+ * The result is kept in pendingResult (and in the output buffer)
+ * to be sent back
+ */
+void updateYourBoard(struct gameContext *game) {
+	int hit = 0;
+	int ship;
+	rowWord byte = 0;
+	if (!checkIndex(game->theirShotX, game->theirShotY)) {
+		byte = readBoard(game, boardBase + game->theirShotY - 1);
+		hit = boardTest(boardAt(game, boardBase), game->theirShotX, game->theirShotY);
+	}
+    LOG_DEBUG("The row byte for row %x is %x \n", game->theirShotY, (unsigned int) byte);
+	if (hit) {
+		conPrintf("Enemy got a hit\n");
+		writeBoard(game, boardBase + game->theirShotY - 1, ~createByte(game->theirShotX) & byte);
+		game->enemyHits = TOTAL_HITS - boardCount(boardAt(game, boardBase));
+		game->pendingResult = RESULT_HIT;
+		ship = game->shipCells[(game->theirShotY - 1) * boardWidth + game->theirShotX - 1];
+		if (--game->shipAfloat[ship] == 0) {
+			conPrintf("The enemy sunk your length %x ship\n", game->fleetShips[ship].length);
+			game->pendingResult = RESULT_SUNK(game->fleetShips[ship].length);
+		}
+	} else {
+		conPrintf("Enemy has missed\n");
+		game->pendingResult = RESULT_MISS;
+	}
+	game->outputBuffer[0] = game->pendingResult;
+	game->outputBuffer[1] = '\0';
+}
+
+/**
+ * enemyCell() returns the character drawn for a cell
+ * of the enemy board given its shot and hit bits
+ */
+unsigned char enemyCell(int bitShot, int bitHit) {
+	if (bitShot & bitHit) {
+		return 'X';
+	} else if (bitShot) {
+		return 'O';
+	}
+	return '-';
+}
+
+/**
+ * fleetCell() returns the character drawn for a cell
+ * of your board given its boat bit
+ */
+unsigned char fleetCell(int bitBoard) {
+	return bitBoard ? 'B' : '-';
+}
+
+/**
+ * labelWidth() returns how many columns the row
+ * labels take up, including the separating space
+ */
+unsigned int labelWidth() {
+	return boardHeight > 26 ? 3 : 2;
+}
+
+/**
+ * cellWidth() returns how many columns each board
+ * cell takes up, including the separating space
+ */
+unsigned int cellWidth() {
+	return boardWidth > 9 ? 3 : 2;
+}
+
+/**
+ * cellColumn() returns the one-based console column
+ * where the cell for the one-based board column x is drawn
+ */
+unsigned int cellColumn(unsigned int x) {
+	return labelWidth() + (x - 1) * cellWidth() + cellWidth() - 1;
+}
+
+/**
+ * printColumnHeader() prints the line of
+ * column numbers above a board
+ */
+void printColumnHeader() {
+	unsigned int x;
+	unsigned int i;
+	for (i = 0; i < labelWidth(); i++) {
+		conPutchar(' ');
+	}
+	for (x = 1; x <= boardWidth; x++) {
+		if (cellWidth() == 3 && x < 10) {
+			conPutchar(' ');
+		}
+		conDecimal(x);
+		if (x < boardWidth) {
+			conPutchar(' ');
+		}
+	}
+	conPrintf("\n");
+}
+
+/**
+ * printRowLabel() prints the letters naming the
+ * one-based row y, padded to the label width
+ */
+void printRowLabel(unsigned int y) {
+	unsigned char label[3];
+	int len = rowLabel(y, label);
+	int i;
+	for (i = 0; i < len; i++) {
+		conPutchar(label[i]);
+	}
+	for (; i < labelWidth(); i++) {
+		conPutchar(' ');
+	}
+}
+
+/**
+ * printCell() prints one board cell padded
+ * to the cell width
+ */
+void printCell(unsigned char c) {
+	if (cellWidth() == 3) {
+		conPutchar(' ');
+	}
+	conPutchar(c);
+	conPutchar(' ');
+}
+
+/**
+ * printEnemyBoard() returns void
+ * Prints an ASCII representation of the enemy's current board state
+ * Confirmed hits are marked with "X", Missed shots are marked with "O",
+ * empty space is marked with "-"
+ */
+void printEnemyBoard(struct gameContext *game) {
+	rowWord shots[MAX_BOARD_HEIGHT];
+	rowWord hits[MAX_BOARD_HEIGHT];
+	rowWord byteShot;
+	rowWord byteHit;
+	int ishift;
+	int irow;
+	int bitShot;
+	int bitHit;
+	readBoardBlock(game, shotsBase, shots, boardHeight);
+	readBoardBlock(game, hitsBase, hits, boardHeight);
+	conPrintf("Current assessment of enemy territory...\n");
+	printColumnHeader();
+	for (irow = 0; irow < boardHeight; irow++) {
+		printRowLabel(irow + 1);
+		byteShot = shots[irow];
+		byteHit = hits[irow];
+		for (ishift = boardWidth - 1; ishift >= 0; ishift--) {
+			bitShot = (byteShot >> ishift) & 0x01;
+			bitHit = (byteHit >> ishift) & 0x01;
+			printCell(enemyCell(bitShot, bitHit));
+		}
+		conPrintf("\n");
+	}
+	conPrintf("\n");
+}
+
+/**
+ * printYourBoard() returns void
+ * Prints an ASCII representation of a player's current board state
+ * Boats are marked with "B", empty space is marked with "-"
+ */
+void printYourBoard(struct gameContext *game) {
+	rowWord board[MAX_BOARD_HEIGHT];
+	rowWord byteBoard;
+	int ishift;
+	int irow;
+	int bitBoard;
+	readBoardBlock(game, boardBase, board, boardHeight);
+	conPrintf("Your fleet...\n");
+	printColumnHeader();
+	for (irow = 0; irow < boardHeight; irow++) {
+		printRowLabel(irow + 1);
+		byteBoard = board[irow];
+		for (ishift = boardWidth - 1; ishift >= 0; ishift--) {
+			bitBoard = (byteBoard >> ishift) & 0x01;
+			printCell(fleetCell(bitBoard));
+		}
+		conPrintf("\n");
+	}
+	conPrintf("\n");
+}
+
+/**
+ * moveCursor() emits the ANSI sequence that moves
+ * the cursor to the given one-based line and column
+ */
+void moveCursor(unsigned int line, unsigned int column) {
+	conPrintf("\033[");
+	conDecimal(line);
+	conPutchar(';');
+	conDecimal(column);
+	conPutchar('H');
+}
+
+/**
+ * drawCell() redraws a single board cell in place,
+ * saving and restoring the cursor in the scroll region
+ */
+void drawCell(unsigned int line, unsigned int x, unsigned char c) {
+	conPrintf("\0337");
+	moveCursor(line, cellColumn(x));
+	conPutchar(c);
+	conPrintf("\0338");
+}
+
+/**
+ * drawBoards() brings both boards on the console up
+ * to date. The first call (or any call in full mode)
+ * draws everything; after that only the cells that differ
+ * from the last drawn frame are redrawn
+ */
+void drawBoards(struct gameContext *game) {
+	rowWord shots[MAX_BOARD_HEIGHT];
+	rowWord hits[MAX_BOARD_HEIGHT];
+	rowWord board[MAX_BOARD_HEIGHT];
+	rowWord changed;
+	int irow;
+	int ishift;
+	readBoardBlock(game, shotsBase, shots, boardHeight);
+	readBoardBlock(game, hitsBase, hits, boardHeight);
+	readBoardBlock(game, boardBase, board, boardHeight);
+	if (renderMode == RENDER_FULL) {
+		printEnemyBoard(game);
+		printYourBoard(game);
+		return;
+	}
+	if (!frameDrawn) {
+		conPrintf("\033[2J\033[H");
+		printEnemyBoard(game);
+		printYourBoard(game);
+		conPrintf("\033[");
+		conDecimal(SCROLL_TOP_LINE);
+		conPrintf(";999r");
+		moveCursor(SCROLL_TOP_LINE, 1);
+		memcpy(drawnShots, shots, boardHeight * sizeof(rowWord));
+		memcpy(drawnHits, hits, boardHeight * sizeof(rowWord));
+		memcpy(drawnBoard, board, boardHeight * sizeof(rowWord));
+		frameDrawn = 1;
+		return;
+	}
+	for (irow = 0; irow < boardHeight; irow++) {
+		changed = (shots[irow] ^ drawnShots[irow]) | (hits[irow] ^ drawnHits[irow]);
+		for (ishift = boardWidth - 1; changed != 0 && ishift >= 0; ishift--) {
+			if ((changed >> ishift) & 0x01) {
+				drawCell(ENEMY_ROW_LINE + irow, boardWidth - ishift,
+						enemyCell((shots[irow] >> ishift) & 0x01, (hits[irow] >> ishift) & 0x01));
+			}
+		}
+		changed = board[irow] ^ drawnBoard[irow];
+		for (ishift = boardWidth - 1; changed != 0 && ishift >= 0; ishift--) {
+			if ((changed >> ishift) & 0x01) {
+				drawCell(FLEET_ROW_LINE + irow, boardWidth - ishift,
+						fleetCell((board[irow] >> ishift) & 0x01));
+			}
+		}
+		drawnShots[irow] = shots[irow];
+		drawnHits[irow] = hits[irow];
+		drawnBoard[irow] = board[irow];
+	}
+}
+
+/**
+ * renderBoards() redraws the boards with drawBoards(),
+ * timing the call in benchmark builds
+ */
+void renderBoards(struct gameContext *game) {
+	BENCH_START(start);
+	drawBoards(game);
+	BENCH_STOP(PHASE_RENDER, start);
+}
+
+/**
+ * releaseScreen() hands the whole screen back to the
+ * terminal once the game no longer redraws the boards
+ */
+void releaseScreen() {
+	if (renderMode == RENDER_ANSI && frameDrawn) {
+		conPrintf("\033[r");
+		moveCursor(999, 1);
+		conPutchar('\n');
+	}
+}
+
+/**
+ * eraseSRAM() returns void
+ * Routine to clear the game boards in the SRAM
+ */
+void eraseSRAM(struct gameContext *game) {
+	unsigned char zeros[64] = {0};
+	int addr;
+	int end = game->sram ? boardRows * rowBytes : 0;
+	for (addr = 0; addr < end; addr += sizeof(zeros)) {
+		writeSRAMBlock(addr, zeros, end - addr < sizeof(zeros) ? end - addr : sizeof(zeros));
+	}
+	if (game->sram) {
+		writeSRAMBlock(LOG_BASE, zeros, LOG_EVENT_SIZE);
+	}
+	clearState(game);
+	game->logPending = 0;
+	game->logLength = 0;
+	loadBoardCache(game);
+}
+
+/**
+ * setIndexHigh() return void
+ * Accepts integers x and y for coordinates, and a base address for a game board
+ * Uses the coordinates to "turn on" a bit at that location on the given board
+ */
+void setIndexHigh(struct gameContext *game, int x, int y, int base) {
+	rowWord byte;
+	byte = readBoard(game, base + y - 1);
+	byte = createByte(x) | byte;
+	writeBoard(game, base + y - 1, byte);
+}
+
+/**
+ * placeShip() returns void
+ * Sets the cells of a ship of the given length on your board
+ * (one row write for a horizontal ship) and records it in the fleet
+ */
+void placeShip(struct gameContext *game, unsigned int x, unsigned int y, int length, int vertical) {
+	struct ship *ship = &game->fleetShips[game->shipCount++];
+	int j;
+	ship->x = x;
+	ship->y = y;
+	ship->length = length;
+	ship->vertical = vertical;
+	for (j = 0; j < (vertical ? length : 1); j++) {
+		writeBoard(game, boardBase + y - 1 + j, readBoard(game, boardBase + y - 1 + j) | shipRowMask(ship));
+	}
+	indexShip(game->shipCells, ship, game->shipCount - 1);
+	game->shipAfloat[game->shipCount - 1] = length;
+}
+
+
+
+/**
+ * placeFleet() returns void
+ * Places every ship on your board at random without
+ * prompting or drawing, starting over if one does not fit
+ */
+void placeFleet(struct gameContext *game) {
+	unsigned int x;
+	unsigned int y;
+	int vertical;
+	int length;
+	for (length = LARGE_SHIP_LENGTH; length >= SMALL_SHIP_LENGTH; length--) {
+		if (randomPlacement(boardAt(game, boardBase), length, &game->placeSeed, &x, &y, &vertical)) {
+			eraseSRAM(game);
+			game->shipCount = 0;
+			length = LARGE_SHIP_LENGTH + 1;
+		} else {
+			placeShip(game, x, y, length, vertical);
+		}
+	}
+}
+
+/**
+ * readPlanToken() reads the next blank-separated token of a
+ * plan from nextChar into token, keeping PLAN_TOKEN - 1
+ * characters of it at most, and returns its full length
+ * (0 once the plan has run out)
+ */
+int readPlanToken(int (*nextChar)(void), unsigned char *token) {
+	int length = 0;
+	int c = nextChar();
+	while (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+		c = nextChar();
+	}
+	while (c >= 0 && c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+		if (length < PLAN_TOKEN - 1) {
+			token[length] = c;
+		}
+		length++;
+		c = nextChar();
+	}
+	token[length < PLAN_TOKEN - 1 ? length : PLAN_TOKEN - 1] = '\0';
+	return length;
+}
+
+/**
+ * readPlan() reads a whole plan from nextChar into scriptPlan
+ * and checks it against scratch bitboards: the player must be
+ * 1 or 2, each ship must fit on the board clear of the ones
+ * before it, and each shot must be on the board and not fired
+ * before. Every problem is reported, and 0 is returned only
+ * if there were none
+ */
+int readPlan(int (*nextChar)(void)) {
+	unsigned char token[PLAN_TOKEN];
+	rowWord fleet[MAX_BOARD_HEIGHT];
+	rowWord shots[MAX_BOARD_HEIGHT];
+	struct ship *ship;
+	unsigned int x;
+	unsigned int y;
+	int length;
+	int used;
+	int bad = 0;
+	int i;
+	memset(fleet, 0, sizeof(fleet));
+	memset(shots, 0, sizeof(shots));
+	scriptPlan.shotCount = 0;
+	scriptPlan.nextShot = 0;
+	length = readPlanToken(nextChar, token);
+	if (length != 1 || (token[0] != '1' && token[0] != '2')) {
+		conPrintf("Script: the plan must start with the player, 1 or 2\n");
+		bad++;
+	}
+	scriptPlan.player = charToInt(token[0]);
+	for (i = 0; i < SHIP_COUNT; i++) {
+		ship = &scriptPlan.ships[i];
+		ship->length = LARGE_SHIP_LENGTH - i;
+		length = readPlanToken(nextChar, token);
+		used = parseCoordinate(token, &y, &x);
+		ship->x = x;
+		ship->y = y;
+		ship->vertical = token[used] == 'v';
+		if (length != used + 1 || (token[used] != 'h' && token[used] != 'v') ||
+				!placementFits(fleet, x, y, ship->length, ship->vertical)) {
+			conPrintf("Script: the length %x ship cannot go at '%s'\n", ship->length, (char *) token);
+			bad++;
+			continue;
+		}
+		for (used = 0; used < (ship->vertical ? ship->length : 1); used++) {
+			fleet[y - 1 + used] |= shipRowMask(ship);
+		}
+	}
+	while ((length = readPlanToken(nextChar, token)) > 0 && strcmp((char *) token, "end") != 0) {
+		used = parseCoordinate(token, &y, &x);
+		if (length != used || checkIndex(x, y) || boardTest(shots, x, y)) {
+			conPrintf("Script: shot %u, '%s', is off the map or fired before\n",
+					(unsigned long long) scriptPlan.shotCount + 1, (char *) token);
+			bad++;
+		} else if (scriptPlan.shotCount == PLAN_SHOTS) {
+			conPrintf("Script: a plan holds at most %u shots\n", (unsigned long long) PLAN_SHOTS);
+			bad++;
+		} else {
+			shots[y - 1] |= createByte(x);
+			scriptPlan.shotX[scriptPlan.shotCount] = x;
+			scriptPlan.shotY[scriptPlan.shotCount] = y;
+		}
+		scriptPlan.shotCount++;
+	}
+	if (scriptPlan.shotCount > PLAN_SHOTS) {
+		scriptPlan.shotCount = PLAN_SHOTS;
+	}
+	return bad != 0;
+}
+
+/**
+ * keyScriptChar() feeds readPlan() from the keyboard
+ */
+int keyScriptChar() {
+	return readKey();
+}
+
+/**
+ * setUpBoats() returns void
+ * Initializes game by placing the player's boats on their board
+ * sizes of the boats are bound by LARGE_SHIP_LENGTH and SMALL_SHIP_LENGTH
+ * where each subsequent boat will be 1 unit smaller than before
+ * The user will be prompted for a coordinate and an orientation
+ * (or, with autoPlay set, they are chosen at random, and with
+ * scriptPlay set they come from the plan; typing "script" at
+ * the prompt reads the plan from the keyboard)
+ * 'v' assumes the ship is placed at the given coordinate and continued down
+ * 'h' assumes the ship is placed at the given coordinate and continued right
+ */
+void setUpBoats(struct gameContext *game) {
+    int i;
+	int fits;
+	int vertical;
+	unsigned int xCoor;
+	unsigned int yCoor;
+	unsigned char orientation;
+	renderBoards(game);
+	for (i = LARGE_SHIP_LENGTH; i >= SMALL_SHIP_LENGTH; i--) {
+		do {
+			if (scriptPlay) {
+				xCoor = scriptPlan.ships[LARGE_SHIP_LENGTH - i].x;
+				yCoor = scriptPlan.ships[LARGE_SHIP_LENGTH - i].y;
+				vertical = scriptPlan.ships[LARGE_SHIP_LENGTH - i].vertical;
+			} else if (autoPlay || autoPlace || cpuPlay) {
+				if (randomPlacement(boardAt(game, boardBase), i, &game->placeSeed, &xCoor, &yCoor, &vertical)) {
+					// No room left for this ship; start the fleet over
+					eraseSRAM(game);
+					game->shipCount = 0;
+					i = LARGE_SHIP_LENGTH + 1;
+					break;
+				}
+			} else {
+				conPrintf("Please choose coordinates for your length %x ship (or auto): ", i);
+				enterString(game);
+				if (strcmp((char *) game->outputBuffer, "auto") == 0) {
+					autoPlace = 1;
+					fits = 0;
+					continue;
+				}
+				if (i == LARGE_SHIP_LENGTH && strcmp((char *) game->outputBuffer, "script") == 0) {
+					scriptPlay = readPlan(keyScriptChar) == 0;
+					fits = 0;
+					continue;
+				}
+				if (game->outputBuffer[parseCoordinate(game->outputBuffer, &yCoor, &xCoor)] != '\0') {
+					yCoor = 0;
+				}
+				do {
+					conPrintf("Please choose either vertical or horizontal orientation (v or h): ");
+					orientation = readKey();
+					readKey();
+				} while (orientation != 'h' && orientation != 'v');
+				vertical = orientation == 'v';
+			}
+
+			fits = placementFits(boardAt(game, boardBase), xCoor, yCoor, i, vertical);
+			if (fits) {
+				placeShip(game, xCoor, yCoor, i, vertical);
+			} else if (!autoPlay && !autoPlace) {
+				conPrintf("Sorry, that location is off the map or already taken\n");
+			}
+		} while (!fits);
+		renderBoards(game);
+	}
+}
+
+#ifdef INSTRUMENT
+/**
+ * dumpProbes() prints the call, byte and cycle counts
+ * gathered by the instrumentation probes so far
+ */
+void dumpProbes() {
+	static const char *names[PROBE_COUNT] = {"sram read", "sram write", "sendChar", "readString"};
+	int id;
+	for (id = 0; id < PROBE_COUNT; id++) {
+		conPrintf("%s: %u calls, %u bytes, %u cycles\n", names[id],
+				probes[id].calls, probes[id].bytes, probes[id].cycles);
+	}
+	conPrintf("parity errors: %u\n", parityErrors);
+	conPrintf("corrected bits: %u\n", correctedBits);
+}
+#endif
+
+#ifndef SMALL_FOOTPRINT
+// Banner (the splash screen art, run-length encoded for conPutsPacked();
+// the runs of one character it is mostly made of shrink it to under a third)
+#define PACKED_RUN 0x80
+const char splashBanner[] =
+	"+\205o++:`\204 /\206o.  .\213o \212o+ /\203o-\202 -\207o+\201 .+s\202hyo:\202 /\203o  /\203o- `\204o  :\205o++:`\n"
+	"d\211Mh.\202 m\206Ms  :\213M \212Mm d\203M/\202 +\207Md  y\210MN:  y\203M  h\203M+ .\204M  s\211Mh`\n"
+	"d\203MysN\202Md\201 .\207Mm  -\201mN\203MN\201m \201m\204M\201mh d\203M/\202 +\203MN\201my +\203M  N\202Md  y\203M  h\203M+ .\204M  s\203Mdsm\202Mo\n"
+	"d\203M\201 \203M\201 +\202MNm\202M.\203 y\203Mo\205 N\203M-\202 d\203M/\202 +\203Mh\203 s\203M  d\202MN  y\203M  h\203M+ .\204M  s\203M\201 \202My\n"
+	"d\203M\201 \202MN\201 y\202Mhh\202M+\203 y\203Mo\205 N\203M-\202 d\203M/\202 +\203Mh\203 /\203MNo\206 y\203M  d\203M+ .\204M  s\203M\201 \202My\n"
+	"d\203MNN\201Mms-\201 N\202M  \202Mh\203 y\203Mo\205 N\203M-\202 d\203M/\202 +\204M\201No  s\205Mms-\202 y\213M+ .\204M  s\203M  N\202Ms\n"
+	"d\203MN\203Mm+  -\203M  \203M`\202 y\203Mo\205 N\203M-\202 d\203M/\202 +\207Mo\201 .om\205Md-  y\213M+ .\204M  s\211Mm.\n"
+	"d\203M\201 \203M: o\203M  \203M/\202 y\203Mo\205 N\203M-\202 d\203M/\202 +\203Md\201:.\204 -sN\203MN` y\203M  d\203M+ .\204M  s\203Mdoo+/-\n"
+	"d\203M\201 \203M+ h\212My\202 y\203Mo\205 N\203M-\202 d\203M/\202 +\203Mh\203 /\203M:  \203M/ y\203M  h\203M+ .\204M  s\203Ms\n"
+	"d\203M\201 \203M+`\213MN\202 y\203Mo\205 N\203M-\202 d\203M+\201. +\203Mh\202. :\203M/  \203M+ y\203M  h\203M+ .\204M  s\203Ms\n"
+	"d\203MmN\204M::\203MN  d\203M-\201 y\203Mo\205 N\203M-\202 d\207M`+\210M-`N\202Mdsm\203M- y\203M  h\203M+ .\204M  s\203Ms\n"
+	"d\211MNo s\203Mh  y\203Ms\201 y\203Mo\205 N\203M-\202 d\207M`+\210M- .yN\206Md:  y\203M  h\203M+ .\204M  s\203Ms\n"
+	".\206-..`\201 .\203-.  `\203-.\201 .\203-`\205 \204-`\202 .\207- `\210-\203 -/\201+/-`\202 .\203-` .\203-`  \204-  `\203-.\n"
+	"\311 \201`-y:`\n"
+	"\311 ../smmo- \n"
+	"\311 -  .mh\n"
+	"\306 `mNm``dh\n"
+	"\305 :/yNo..dh\n"
+	"\305 dm\202NmNh\n"
+	"\277 `+o:`\201 -dd+/s.\n"
+	"\277 h\202N-  :dhy.\n"
+	"\272 \201.-://dNh-.`-dys\n"
+	"\266 .:/:..-yd\205Nh:dyy\n"
+	"\264 -d\203Nh.`:\205Nm:dyd/y:\n"
+	"\264 y\205Ny .\205Nm:NNmyNo\n"
+	"\263 h\205Nh-+\211Ndoo:\n"
+	"  ``:\253 \201. d\224N//-\n"
+	"s\201Ny\252 .\201Nm\225Nyys++`\n"
+	"/Nms+o\231 \204`\211 y\240Nmhyo+:-`\207 :oo-.`+ys:.`\222 `\n"
+	":-\201 :\221 ``  ``:h\204N+\210 \251Nd\203o/`-mNNm/+\201Nm/.\221 ++\n"
+	"\203 :\221 ..--/h\206Ny\207 .\275Nm\201hmh\201y+\202 `.\201 oN/\n"
+	"\202 :/.-.:..:.-..:..-..-..-..-yd\205No-++/-\201`-+\307N.  -mNo `hh-\n"
+	"\202 `om\201N\203m\201d\201hyyhssyoossm\205Nhd\202Nyoo\311Ny-+\202N+/\201+:-..\n"
+	"\204 `s\377NNNo\n"
+	"\206 .s\377No\n"
+	"\210 .h\375N:\n"
+	"\212 /\373Nm`\n"
+	"\213 .h\314N\221m\217d\207hs\n"
+	"\214 :h\201d\262h\301ys:\n"
+	"\212 .o\315y\254so\n"
+	"\210 `/\244y\307so+\204o\202+//::-\n"
+	"\206 `:\302soss\250o+  .+oo. ./.\n"
+	"\204 `/o\213s\203o\201+/oo\201s\202o/\203o:-+\276o\210+.\201 `-`  `+/\n"
+	"\203 .//\201:-:--:.-..-``.``.\201`./+\204o+\202.`\203 /\220o\235+/:/\202+:\203+:`` ``\214 `:`\n"
+	"\203 `-\205`\212 \201`.-/\206+.\207 -\245+//:-.``\203 `:/:.``\201:``\n"
+	" `\202 .\227 `-\201:\201-\210 `/\212+\222/--..`\n"
+	" :/:-.-\252 .\201/:\225/`-\n"
+	" `-::/-\257 :\204/\215:-`.`\n"
+	"\266 -\205:. `\206:.::--:.\n"
+	"\266 .-\203:-` `\206-`-.-`.`\n"
+	"\270 ``.`` `..\205-.`\201.\n"
+	"\301 ``\201.`  `\201.\n"
+	"\301 `\201.`\202 \203`\n"
+	"\310 \206`\n";
+
+/**
+ * conPutsPacked() appends run-length encoded text to the
+ * console buffer: a byte below PACKED_RUN stands for itself,
+ * and PACKED_RUN | n for the byte after it repeated n + 2 times
+ */
+void conPutsPacked(const char *packed) {
+	const unsigned char *p = (const unsigned char *) packed;
+	unsigned int count;
+	for (; *p != '\0'; p++) {
+		count = 1;
+		if (*p & PACKED_RUN) {
+			count = (*p & ~PACKED_RUN) + 2;
+			p++;
+		}
+		while (count-- > 0) {
+			conPutchar(*p);
+		}
+	}
+}
+#endif
+
+/**
+ * showSplash() returns void
+ * Prints the title banner and the rules of the game
+ * (a SMALL_FOOTPRINT build only prints the welcome)
+ */
+void showSplash() {
+#ifdef SMALL_FOOTPRINT
+	conPrintf("Welcome to the warzone!\n\n");
+#else
+	conPutsPacked(splashBanner);
+	conPrintf("Welcome to the warzone!\n");
+	conPrintf("The first rule of Battleship is that the last man standing wins. Aside from that, here are some guidelines:\n");
+	conPrintf("\t- You will place your ships, starting from your biggest ship (length %x) down to your smallest ship (length %x)\n",
+			LARGE_SHIP_LENGTH, SMALL_SHIP_LENGTH);
+	conPrintf("\t- The game uses coordinates like A1 and C6, where A - H are valid horizontal coordinates and 1 - 8 are valid vertical coordinates\n");
+	conPrintf("\t- The commanders of the ships must agree upon the order in which the firefight shall commence (Player 1 and Player 2)\n");
+	conPrintf("\t- Once the game is underway, each side may fire upon the other as his or her turn comes by entering a coordinate to fire upon\n");
+	conPrintf("\t- Your map of the enemy territory shows O's where you have shot previously, and X's where you have shot and made a hit\n");
+	conPrintf("\t- Your ships are displayed using B's to denote where you still have ships (or fragments of ships, at least)\n");
+	conPrintf("\t- Artillery and shrapnel will follow, until such a point when either you or your enemy has succumbed to the cold blue depths of the Pacific\n");
+	conPrintf("\t- The war is over, and the victorious side may now loot and plunder the land of the loser\n\n");
+	conPrintf("Let the games begin!\n\n");
+#endif
+}
+
+/**
+ * resetGame() returns void
+ * Clears the SRAM and all per-game state so a new game
+ * can start, forcing the next render to draw everything
+ * (for the game in the SRAM, the only one on the screen)
+ */
+void resetGame(struct gameContext *game) {
+	game->yourHits = 0;
+	game->enemyHits = 0;
+	game->yourShotX = 0;
+	game->yourShotY = 0;
+	game->shipCount = 0;
+	game->pendingResult = RESULT_NONE;
+	game->sentFrameCount = 0;
+	game->awaitingReplay = 0;
+	game->txSeq = 0;
+	game->rxSeq = 0;
+	game->player = 0;
+	game->yourTurn = 0;
+	if (game->sram) {
+		frameDrawn = 0;
+	}
+	eraseSRAM(game);
+	aiReset(&game->ai);
+	game->ai.seed = rand();
+	game->placeSeed = rand();
+}
+
+/**
+ * resumeGame() picks up the game left in the SRAM by a
+ * reset of the board: if the resume state there is intact
+ * and matches the boards, the board size, the boards and the
+ * rest of the state are restored (the CPU player's maps are
+ * rebuilt from the shots and the sunk ships, the fleet index
+ * from the fleet) and the context is returned, ready
+ * for playTurns(). Returns 0 if there is nothing to resume
+ */
+struct gameContext *resumeGame() {
+	unsigned char state[RESUME_SIZE];
+	rowWord shots[MAX_BOARD_HEIGHT];
+	rowWord hits[MAX_BOARD_HEIGHT];
+	struct gameContext *game;
+	struct ship ship;
+	unsigned int width = boardWidth;
+	unsigned int height = boardHeight;
+	unsigned int x;
+	unsigned int y;
+	int i;
+	readSRAMBlock(RESUME_BASE, state, RESUME_SIZE);
+	if (state[0] != RESUME_MAGIC || (state[3] != 1 && state[3] != 2) ||
+			state[12] > SHIP_COUNT || state[RESUME_SUNK] > SHIP_COUNT || setBoardSize(state[1], state[2])) {
+		return 0;
+	}
+	game = gameContextInit(gameArena, 1);
+	loadBoardCache(game);
+	if (stateChecksum(game, state) != ((state[RESUME_SIZE - 2] << 8) | state[RESUME_SIZE - 1])) {
+		setBoardSize(width, height);
+		return 0;
+	}
+	game->player = state[3];
+	game->yourTurn = state[4];
+	game->yourHits = state[5];
+	game->enemyHits = state[6];
+	game->pendingResult = state[7];
+	game->yourShotX = state[8];
+	game->yourShotY = state[9];
+	game->txSeq = state[10];
+	game->rxSeq = state[11];
+	game->shipCount = state[12];
+	game->sentFrameCount = state[13];
+	game->sentSeqs[0] = state[14];
+	game->logLength = (state[15] << 8) | state[16];
+	memcpy(game->sentFrames[0], state + RESUME_FRAME, bufLen);
+	for (i = 0; i < game->shipCount; i++) {
+		game->fleetShips[i].x = state[RESUME_SHIPS + 4 * i];
+		game->fleetShips[i].y = state[RESUME_SHIPS + 4 * i + 1];
+		game->fleetShips[i].length = state[RESUME_SHIPS + 4 * i + 2];
+		game->fleetShips[i].vertical = state[RESUME_SHIPS + 4 * i + 3];
+	}
+	indexFleet(game);
+	// Fold every shot that already has its result back into the maps
+	aiReset(&game->ai);
+	game->ai.seed = rand();
+	memset(shots, 0, sizeof(shots));
+	memset(hits, 0, sizeof(hits));
+	for (y = 1; y <= boardHeight; y++) {
+		for (x = 1; x <= boardWidth; x++) {
+			if (!boardTest(boardAt(game, shotsBase), x, y) ||
+					(!game->yourTurn && x == game->yourShotX && y == game->yourShotY)) {
+				continue;
+			}
+			shots[y - 1] |= createByte(x);
+			if (boardTest(boardAt(game, hitsBase), x, y)) {
+				hits[y - 1] |= createByte(x);
+			}
+			aiObserve(&game->ai, shots, hits, x, y, boardTest(hits, x, y));
+		}
+	}
+	for (i = 0; i < state[RESUME_SUNK]; i++) {
+		ship.x = state[RESUME_SUNK + 1 + 4 * i];
+		ship.y = state[RESUME_SUNK + 1 + 4 * i + 1];
+		ship.length = state[RESUME_SUNK + 1 + 4 * i + 2];
+		ship.vertical = state[RESUME_SUNK + 1 + 4 * i + 3];
+		aiMarkSunk(&game->ai, &ship);
+	}
+	if (game->ai.sunkCount != 0) {
+		aiRebuild(&game->ai, shots, hits);
+	}
+	return game;
+}
+
+/**
+ * chooseShot() fills the output buffer with a
+ * coordinate to fire at that has not been fired at
+ * before, prompting the user for it (or, with autoPlay
+ * set, choosing one at random, or with scriptPlay set,
+ * taking the plan's next one). With cpuPlay set the CPU
+ * player picks it instead; typing "cpu" at the prompt hands
+ * the rest of the game to it. In INSTRUMENT builds typing
+ * "stats" prints the probe counters instead
+ */
+void chooseShot(struct gameContext *game) {
+	int notValidMove = 1;
+	unsigned int x;
+	unsigned int y;
+	while (notValidMove) {
+		if (scriptPlay && !cpuPlay && scriptPlan.nextShot == scriptPlan.shotCount) {
+			conPrintf("The plan is out of shots, the CPU player takes over\n");
+			cpuPlay = 1;
+		}
+		if (scriptPlay && !cpuPlay) {
+			formatCoordinate(scriptPlan.shotY[scriptPlan.nextShot], scriptPlan.shotX[scriptPlan.nextShot],
+					game->outputBuffer);
+			scriptPlan.nextShot++;
+		} else if (cpuPlay && !aiChooseShot(&game->ai, boardAt(game, shotsBase), &x, &y)) {
+			formatCoordinate(y, x, game->outputBuffer);
+		} else if (autoPlay) {
+			formatCoordinate(1 + rand() % boardHeight, 1 + rand() % boardWidth, game->outputBuffer);
+		} else {
+			conPrintf("Please enter a coordinate to fire at (or cpu): ");
+			enterString(game);
+			if (strcmp((char *) game->outputBuffer, "cpu") == 0) {
+				cpuPlay = 1;
+				continue;
+			}
+#ifdef INSTRUMENT
+			if (strcmp((char *) game->outputBuffer, "stats") == 0) {
+				dumpProbes();
+				continue;
+			}
+#endif
+		}
+		translateOutputBuffer(game);
+		notValidMove = checkIndex(game->yourShotX, game->yourShotY) ||
+				checkMove(game, game->yourShotX, game->yourShotY, shotsBase);
+	}
+}
+
+/**
+ * fireShot() sends the shot in the output buffer, behind
+ * the pending result, and marks it on the shots board
+ */
+void fireShot(struct gameContext *game) {
+	prependResult(game);
+	sendString(game);
+	LOG_DEBUG("Updating shots board:\n");
+	updateEnemyBoard(game, shotsBase);
+}
+
+/**
+ * takeResult() applies the result at the front of the turn
+ * message in the input buffer to your last shot, telling the
+ * CPU player about any ship it sank, and returns 1 if that
+ * shot sank the last enemy ship. Before your first shot
+ * there is nothing to apply (the opening RESULT_NONE arrives
+ * as a miss in binary wire mode)
+ */
+int takeResult(struct gameContext *game) {
+	int hit = resultHit(game->inputBuffer[0]);
+	int sunk = resultSunk(game->inputBuffer[0]);
+	if (game->yourShotX == 0) {
+		return 0;
+	}
+	if (hit) {
+		LOG_DEBUG("Updating hits board:\n");
+		updateEnemyBoard(game, hitsBase);
+		game->yourHits = boardCount(boardAt(game, hitsBase));
+	}
+	if (hit || game->inputBuffer[0] == RESULT_MISS) {
+		aiObserve(&game->ai, boardAt(game, shotsBase), boardAt(game, hitsBase),
+				game->yourShotX, game->yourShotY, hit);
+		logEvent(game, EVENT_SHOT, hit ? EVENT_HIT : 0, game->yourShotX - 1, game->yourShotY - 1);
+	}
+	if (sunk) {
+		conPrintf("You sunk the enemy's length %x ship\n", sunk);
+		aiSink(&game->ai, boardAt(game, shotsBase), boardAt(game, hitsBase),
+				game->yourShotX, game->yourShotY, sunk);
+	}
+	return game->yourHits == TOTAL_HITS;
+}
+
+/**
+ * takeShot() applies the enemy's shot in the turn message in
+ * the input buffer to your board. If it sank your last ship the
+ * final result is sent straight away and 1 is returned
+ */
+int takeShot(struct gameContext *game) {
+	translateInputBuffer(game);
+	conPrintf("Enemy has fired on coordinate %s\n", (char *) game->inputBuffer + 1);
+	LOG_DEBUG("Translates to integer coordinate %x%x\n", game->theirShotY, game->theirShotX);
+	updateYourBoard(game);
+	logEvent(game, EVENT_INCOMING, resultHit(game->pendingResult) ? EVENT_HIT : 0,
+			game->theirShotX - 1, game->theirShotY - 1);
+	if (boardEmpty(boardAt(game, boardBase))) {
+		sendString(game);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * playTurns() returns 1 if you win and 0 if you lose
+ * Runs the turn loop of one game as the given player
+ * (1 fires first) until either fleet is sunk
+ */
+int playTurns(struct gameContext *game, int player) {
+	int otherPlayer = 3 - player;
+	int i;
+	if (game->player == 0) {
+		game->player = player;
+		game->yourTurn = 2 - player;
+		logEvent(game, EVENT_GAME, player, boardWidth, boardHeight);
+		for (i = 0; i < game->shipCount; i++) {
+			logEvent(game, EVENT_PLACE, game->fleetShips[i].length | (game->fleetShips[i].vertical ? EVENT_VERTICAL : 0),
+					game->fleetShips[i].x - 1, game->fleetShips[i].y - 1);
+		}
+	}
+	while (boardCount(boardAt(game, hitsBase)) != TOTAL_HITS && !boardEmpty(boardAt(game, boardBase))) {
+		if (game->yourTurn) {
+			chooseShot(game);
+			// The shot is on its way; update and draw the local state while the
+			// other player works out the result
+			fireShot(game);
+			game->yourTurn = 0;
+			renderBoards(game);
+			requestSync(game);
+		} else {
+			conPrintf("Waiting for player %x to make a move...", otherPlayer);
+			readString(game);
+			if (takeResult(game) || takeShot(game)) {
+				break;
+			}
+			game->yourTurn = 1;
+			renderBoards(game);
+			requestSync(game);
+		}
+	}
+	logEvent(game, EVENT_OVER, boardCount(boardAt(game, hitsBase)) == TOTAL_HITS ? EVENT_WON : 0, 0, 0);
+	game->player = 0;
+	clearState(game);
+	syncBoards(game);
+	renderBoards(game);
+	return boardCount(boardAt(game, hitsBase)) == TOTAL_HITS;
+}
+
+#ifdef BENCHMARK
+/**
+ * benchRecord() adds one timed call of the
+ * given phase to its latency histogram
+ */
+void benchRecord(int phase, unsigned long long elapsed) {
+	struct phaseStats *stats = &benchStats[phase];
+	int bucket = 0;
+	while (bucket < BENCH_BUCKETS - 1 && (elapsed >> (bucket + 1)) != 0) {
+		bucket++;
+	}
+	stats->buckets[bucket]++;
+	if (stats->count == 0 || elapsed < stats->min) {
+		stats->min = elapsed;
+	}
+	if (elapsed > stats->max) {
+		stats->max = elapsed;
+	}
+	stats->count++;
+	stats->total += elapsed;
+}
+
+/**
+ * benchReport() prints the latency histogram of every
+ * phase along with the number of games played per second
+ */
+void benchReport(int player, int games, unsigned long long elapsed) {
+	static const char *names[PHASE_COUNT] = {"sram", "send", "recv", "render"};
+	struct phaseStats *stats;
+	int phase;
+	int bucket;
+	conPrintf("player %u: %u games in %u %s, %u games/s\n", player, games, elapsed,
+			BENCH_UNIT, elapsed ? games * benchFreq() / elapsed : 0);
+	for (phase = 0; phase < PHASE_COUNT; phase++) {
+		stats = &benchStats[phase];
+		if (stats->count == 0) {
+			continue;
+		}
+		conPrintf("  %s: %u calls, min %u, mean %u, max %u %s\n", names[phase], stats->count,
+				stats->min, stats->total / stats->count, stats->max, BENCH_UNIT);
+		for (bucket = 0; bucket < BENCH_BUCKETS; bucket++) {
+			if (stats->buckets[bucket]) {
+				conPrintf("    < %u: %u\n", 2ULL << bucket, stats->buckets[bucket]);
+			}
+		}
+	}
+	conFlush();
+}
+
+/**
+ * runBenchmark() plays games with random placements and
+ * shots through the regular game loop and reports how long
+ * each phase took. On the host it plays against a forked
+ * copy of itself unless --listen or --connect is given
+ */
+int runBenchmark(int argc, char **argv) {
+	struct gameContext *game;
+	int player = 1;
+	int games = benchGames;
+	int i;
+	unsigned long long start;
+#ifdef HOST_SIM
+	int fds[2];
+	int console;
+	pid_t child = 0;
+	if (hostOptions(&argc, &argv)) {
+		return 1;
+	}
+	games = benchGames;
+	if (argc == 1) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+			perror("socketpair");
+			return 1;
+		}
+		child = fork();
+		player = child == 0 ? 2 : 1;
+		hostLinkFd = fds[player - 1];
+		close(fds[2 - player]);
+	} else if (hostInit(argc, argv)) {
+		return 1;
+	} else {
+		player = strcmp(argv[1], "--listen") == 0 ? 1 : 2;
+	}
+	srand(getpid());
+	fflush(stdout);
+	console = dup(STDOUT_FILENO);
+	freopen("/dev/null", "w", stdout);
+#else
+	alt_timestamp_start();
+	conPrintf("Are you player 1 or 2? ");
+	player = charToInt(readKey());
+	readKey();
+	srand(benchNow());
+#endif
+	autoPlay = 1;
+	game = gameContextInit(gameArena, 1);
+	initLink();
+	start = benchNow();
+	for (i = 0; i < games; i++) {
+		resetGame(game);
+		setUpBoats(game);
+		syncBoards(game);
+		playTurns(game, player);
+	}
+	flushLink(game);
+	conFlush();
+#ifdef HOST_SIM
+	dup2(console, STDOUT_FILENO);
+	if (child > 0) {
+		waitpid(child, 0, 0);
+	}
+#endif
+	benchReport(player, games, benchNow() - start);
+	return 0;
+}
+#endif
+
+#ifdef ANALYSIS
+// A batch of games between two strategies, the first one firing first
+struct simTask {
+	unsigned int first;
+	unsigned int second;
+	unsigned int games;
+	unsigned int seed;
+};
+
+// The totals for every ordered pair of strategies
+struct simResults {
+	unsigned long long games[STRATEGY_COUNT][STRATEGY_COUNT];
+	unsigned long long firstWins[STRATEGY_COUNT][STRATEGY_COUNT];
+	unsigned long long turns[STRATEGY_COUNT][STRATEGY_COUNT];
+	unsigned long long winnerShots[STRATEGY_COUNT][STRATEGY_COUNT];
+};
+
+// Everything one worker thread touches while playing, allocated as one
+// block per worker: its task queue (the owner pops from the tail, idle
+// workers steal from the head), the game contexts of both sides with
+// their strategies and shot counts, and its totals
+struct simWorker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct simTask *tasks;
+	unsigned int head;
+	unsigned int tail;
+	struct gameContext *games[2];
+	unsigned int strategies[2];
+	unsigned int fired[2];
+	struct simResults results;
+	struct simWorker **workers;
+	unsigned int workerCount;
+	unsigned int index;
+};
+
+/**
+ * simSend() is the linkSend hook of an analysis game: the
+ * turn message is handed to the other side whole, so the
+ * coded bytes have nowhere to go
+ */
+void simSend(struct gameContext *game, unsigned char frame) {
+}
+
+/**
+ * simPlay() plays one game between the worker's two sides,
+ * side 0 firing first, and returns the index of the winner.
+ * Each turn goes through the same steps as playTurns(), with
+ * the turn message copied straight into the other side's
+ * input buffer
+ */
+int simPlay(struct simWorker *worker, unsigned int *seed) {
+	struct gameContext *game;
+	struct gameContext *other;
+	unsigned int x;
+	unsigned int y;
+	int turn;
+	for (turn = 0; turn < 2; turn++) {
+		game = worker->games[turn];
+		resetGame(game);
+		game->ai.hitWeight = worker->strategies[turn] == STRATEGY_TARGET ? AI_HIT_WEIGHT : 0;
+		game->ai.seed = nextRandom(seed);
+		game->placeSeed = nextRandom(seed);
+		placeFleet(game);
+		worker->fired[turn] = 0;
+	}
+	for (turn = 0; ; turn ^= 1) {
+		game = worker->games[turn];
+		other = worker->games[turn ^ 1];
+		if (worker->strategies[turn] == STRATEGY_RANDOM) {
+			randomShot(boardAt(game, shotsBase), &game->ai.seed, &x, &y);
+			formatCoordinate(y, x, game->outputBuffer);
+			translateOutputBuffer(game);
+		} else {
+			chooseShot(game);
+		}
+		fireShot(game);
+		worker->fired[turn]++;
+		memcpy(other->inputBuffer, game->outputBuffer, bufLen);
+		if (takeResult(other)) {
+			return turn ^ 1;
+		}
+		if (takeShot(other)) {
+			return turn;
+		}
+	}
+}
+
+/**
+ * simTakeTask() copies the next task for the given worker into
+ * task: its own newest one, or else the oldest one queued on
+ * another worker. Returns 1 once every queue is empty
+ */
+int simTakeTask(struct simWorker *worker, struct simTask *task) {
+	struct simWorker *victim;
+	unsigned int i;
+	for (i = 0; i < worker->workerCount; i++) {
+		victim = worker->workers[(worker->index + i) % worker->workerCount];
+		pthread_mutex_lock(&victim->lock);
+		if (victim->head != victim->tail) {
+			*task = victim == worker ? victim->tasks[--victim->tail] : victim->tasks[victim->head++];
+			pthread_mutex_unlock(&victim->lock);
+			return 0;
+		}
+		pthread_mutex_unlock(&victim->lock);
+	}
+	return 1;
+}
+
+/**
+ * simWorkerMain() plays tasks until there are none
+ * left anywhere, adding up the results as it goes
+ */
+void *simWorkerMain(void *arg) {
+	struct simWorker *worker = arg;
+	struct simResults *results = &worker->results;
+	struct simTask task;
+	unsigned int seed;
+	unsigned int i;
+	int winner;
+	while (!simTakeTask(worker, &task)) {
+		seed = task.seed;
+		worker->strategies[0] = task.first;
+		worker->strategies[1] = task.second;
+		for (i = 0; i < task.games; i++) {
+			winner = simPlay(worker, &seed);
+			results->games[task.first][task.second]++;
+			results->firstWins[task.first][task.second] += winner == 0;
+			results->turns[task.first][task.second] += worker->fired[0] + worker->fired[1];
+			results->winnerShots[task.first][task.second] += worker->fired[winner];
+		}
+	}
+	return 0;
+}
+
+/**
+ * conPercent() prints count out of total
+ * as a percentage with one decimal
+ */
+void conPercent(unsigned long long count, unsigned long long total) {
+	unsigned long long tenths = total ? (count * 1000 + total / 2) / total : 0;
+	conPrintf("%u.%u%%", tenths / 10, tenths % 10);
+}
+
+/**
+ * analysisReport() prints, for every pairing, how often the first
+ * strategy won and how long the games ran, then each strategy's
+ * overall win rate and the shots it needs to sink a fleet
+ */
+void analysisReport(const struct simResults *results, unsigned long long elapsed) {
+	static const char *names[STRATEGY_COUNT] = {"random", "density", "target"};
+	unsigned long long total = 0;
+	unsigned long long played;
+	unsigned long long won;
+	int a;
+	int b;
+	for (a = 0; a < STRATEGY_COUNT; a++) {
+		for (b = 0; b < STRATEGY_COUNT; b++) {
+			played = results->games[a][b];
+			total += played;
+			conPrintf("%s vs %s: %u games, first wins ", names[a], names[b], played);
+			conPercent(results->firstWins[a][b], played);
+			conPrintf(", %u turns a game\n", played ? results->turns[a][b] / played : 0ULL);
+		}
+	}
+	for (a = 0; a < STRATEGY_COUNT; a++) {
+		played = 0;
+		won = 0;
+		for (b = 0; b < STRATEGY_COUNT; b++) {
+			played += results->games[a][b] + results->games[b][a];
+			won += results->firstWins[a][b] + results->games[b][a] - results->firstWins[b][a];
+		}
+		conPrintf("%s: wins ", names[a]);
+		conPercent(won, played);
+		// The mirror match has a winner every game, so it gives the
+		// shots the strategy needs against an equal opponent
+		conPrintf(", %u shots to sink a fleet\n",
+				results->games[a][a] ? results->winnerShots[a][a] / results->games[a][a] : 0ULL);
+	}
+	conPrintf("%u games in %u ns, %u games/s\n", total, elapsed,
+			elapsed ? total * benchFreq() / elapsed : 0ULL);
+	conFlush();
+}
+
+/**
+ * runAnalysis() plays --games games for every ordered pair of
+ * strategies on --threads worker threads (one per core by default)
+ * and prints the results
+ */
+int runAnalysis(int argc, char **argv) {
+	struct simWorker **workers;
+	struct simWorker *worker;
+	struct simResults results;
+	struct simTask task;
+	unsigned long long start;
+	unsigned int offset = (sizeof(struct simWorker) + sizeof(rowWord) - 1) / sizeof(rowWord) * sizeof(rowWord);
+	unsigned int size;
+	unsigned int count;
+	unsigned int batches;
+	unsigned int left;
+	unsigned int n = 0;
+	unsigned int i;
+	int a;
+	int b;
+	if (hostOptions(&argc, &argv)) {
+		return 1;
+	}
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s [--size WxH] [--games N] [--threads N]\n", argv[0]);
+		return 1;
+	}
+	size = (gameContextSize() + sizeof(rowWord) - 1) / sizeof(rowWord) * sizeof(rowWord);
+	count = analysisThreads ? analysisThreads : sysconf(_SC_NPROCESSORS_ONLN);
+	count = count ? count : 1;
+	batches = STRATEGY_COUNT * STRATEGY_COUNT * ((analysisGames + ANALYSIS_BATCH - 1) / ANALYSIS_BATCH);
+	workers = calloc(count, sizeof(*workers));
+	if (workers == 0) {
+		perror("calloc");
+		return 1;
+	}
+	for (i = 0; i < count; i++) {
+		// One arena per worker: its state, the contexts of both sides and
+		// its task queue
+		worker = calloc(1, offset + 2 * size + batches * sizeof(struct simTask));
+		if (worker == 0) {
+			perror("calloc");
+			return 1;
+		}
+		for (a = 0; a < 2; a++) {
+			worker->games[a] = gameContextInit((char *) worker + offset + a * size, 0);
+			worker->games[a]->linkSend = simSend;
+		}
+		worker->tasks = (struct simTask *) ((char *) worker + offset + 2 * size);
+		pthread_mutex_init(&worker->lock, 0);
+		worker->workers = workers;
+		worker->workerCount = count;
+		worker->index = i;
+		workers[i] = worker;
+	}
+	// Deal the batches out round robin; stealing evens out the rest
+	for (a = 0; a < STRATEGY_COUNT; a++) {
+		for (b = 0; b < STRATEGY_COUNT; b++) {
+			for (left = analysisGames; left > 0; left -= task.games) {
+				task.first = a;
+				task.second = b;
+				task.games = left < ANALYSIS_BATCH ? left : ANALYSIS_BATCH;
+				task.seed = (n + 1) * 2654435761u;
+				worker = workers[n++ % count];
+				worker->tasks[worker->tail++] = task;
+			}
+		}
+	}
+	// The CPU player picks the shots, and the workers keep off the console
+	cpuPlay = 1;
+	conMuted = 1;
+	start = benchNow();
+	for (i = 0; i < count; i++) {
+		if (pthread_create(&workers[i]->thread, 0, simWorkerMain, workers[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	memset(&results, 0, sizeof(results));
+	for (i = 0; i < count; i++) {
+		worker = workers[i];
+		pthread_join(worker->thread, 0);
+		for (a = 0; a < STRATEGY_COUNT; a++) {
+			for (b = 0; b < STRATEGY_COUNT; b++) {
+				results.games[a][b] += worker->results.games[a][b];
+				results.firstWins[a][b] += worker->results.firstWins[a][b];
+				results.turns[a][b] += worker->results.turns[a][b];
+				results.winnerShots[a][b] += worker->results.winnerShots[a][b];
+			}
+		}
+	}
+	conMuted = 0;
+	conPrintf("%u threads, %ux%u board\n", (unsigned long long) count,
+			(unsigned long long) boardWidth, (unsigned long long) boardHeight);
+	analysisReport(&results, benchNow() - start);
+	for (i = 0; i < count; i++) {
+		free(workers[i]);
+	}
+	free(workers);
+	return 0;
+}
+#endif
+
+#ifdef SERVER
+// One client of the server: its socket, what is still to be sent to it
+// and, in the same allocation, the game context the CPU player plays it with
+struct session {
+	int fd;
+	unsigned int id;
+	unsigned char closing;
+	unsigned char finished;
+	unsigned char stalled;
+	unsigned char txLength;
+	unsigned char tx[SESSION_TX_SIZE];
+	struct linkDecoder decoder;
+	struct gameContext *game;
+	struct session *next;
+};
+
+/**
+ * sessionSend() is the linkSend hook of a session's game:
+ * it queues one parity-tagged byte for the client
+ */
+void sessionSend(struct gameContext *game, unsigned char frame) {
+	struct session *session = game->linkData;
+	if (session->txLength == SESSION_TX_SIZE) {
+		session->closing = 1;
+		return;
+	}
+	session->tx[session->txLength++] = frame;
+}
+
+/**
+ * sessionRoom() returns 1 if the session's output
+ * buffer can take the most one frame from the
+ * client makes it send
+ */
+int sessionRoom(struct session *session) {
+	return SESSION_TX_SIZE - session->txLength >= SESSION_BURST;
+}
+
+/**
+ * sessionFlush() sends as much of the queued output as
+ * the socket takes. Returns -1 if the client is gone
+ */
+int sessionFlush(struct session *session) {
+	int sent;
+	if (session->txLength == 0) {
+		return 0;
+	}
+	sent = send(session->fd, session->tx, session->txLength, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (sent < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+	}
+	memmove(session->tx, session->tx + sent, session->txLength - sent);
+	session->txLength -= sent;
+	return 0;
+}
+
+/**
+ * sessionOpen() accepts a client and sets up its session
+ * with a freshly placed fleet. Returns 0 if accept failed
+ */
+struct session *sessionOpen(int listener, unsigned int id) {
+	struct session *session;
+	unsigned int offset = (sizeof(struct session) + sizeof(rowWord) - 1) / sizeof(rowWord) * sizeof(rowWord);
+	int fd = accept(listener, 0, 0);
+	int one = 1;
+	if (fd < 0) {
+		return 0;
+	}
+	session = malloc(offset + gameContextSize());
+	if (session == 0) {
+		close(fd);
+		return 0;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	session->fd = fd;
+	session->id = id;
+	session->closing = 0;
+	session->finished = 0;
+	session->stalled = 0;
+	session->txLength = 0;
+	session->decoder.half = 0;
+	session->game = gameContextInit((char *) session + offset, 0);
+	session->game->linkSend = sessionSend;
+	session->game->linkData = session;
+	resetGame(session->game);
+	placeFleet(session->game);
+	return session;
+}
+
+/**
+ * serveTurn() answers the client's turn message in the
+ * session's input buffer: the result of its shot, then the
+ * CPU player's next shot. Returns 1 once the game is over
+ */
+int serveTurn(struct session *session) {
+	struct gameContext *game = session->game;
+	unsigned int x;
+	unsigned int y;
+	if (takeResult(game)) {
+		fprintf(stderr, "session %u: server won\n", session->id);
+		return 1;
+	}
+	if (takeShot(game)) {
+		fprintf(stderr, "session %u: client won\n", session->id);
+		return 1;
+	}
+	aiChooseShot(&game->ai, boardAt(game, shotsBase), &x, &y);
+	formatCoordinate(y, x, game->outputBuffer);
+	translateOutputBuffer(game);
+	fireShot(game);
+	return 0;
+}
+
+/**
+ * sessionRead() feeds whatever the client has sent through
+ * the frame parser, playing a turn for each complete turn
+ * message, as long as the output buffer has room for what
+ * a frame sends (see sessionRoom()); only the bytes fed are
+ * taken off the socket. Returns -1 if the client closed its
+ * end. A finished game stays open to answer NAKs until the
+ * client hangs up
+ */
+int sessionRead(struct session *session) {
+	unsigned char buf[256];
+	unsigned short received;
+	int got;
+	int i;
+	int status;
+	got = recv(session->fd, buf, sizeof(buf), MSG_DONTWAIT | MSG_PEEK);
+	if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+		return -1;
+	}
+	session->stalled = 0;
+	for (i = 0; i < got && !session->closing && sessionRoom(session); i++) {
+		received = decodeLinkByte(&session->decoder, buf[i]);
+		if (received == RX_PENDING) {
+			continue;
+		}
+		status = feedFrame(session->game, received);
+		if (status != FRAME_PENDING && acceptFrame(session->game, status) &&
+				!session->finished && serveTurn(session)) {
+			session->finished = 1;
+		}
+	}
+	if (i > 0) {
+		recv(session->fd, buf, i, MSG_DONTWAIT);
+	}
+	return 0;
+}
+
+/**
+ * sessionRetry() repeats the NAK of every session still
+ * waiting for the replay it asked for, and NAKs a frame
+ * that has not been finished since the last call. A
+ * session whose output is backed up is left until it
+ * has room again
+ */
+void sessionRetry(struct session *session) {
+	for (; session != 0; session = session->next) {
+		if (session->closing || !sessionRoom(session)) {
+			continue;
+		}
+		if (frameStarted(session->game) && session->stalled) {
+			dropFrame(session->game);
+			acceptFrame(session->game, FRAME_TIMEOUT);
+		} else if (session->game->awaitingReplay) {
+			sendControl(session->game, FRAME_NAK);
+		}
+		session->stalled = 1;
+		sessionFlush(session);
+	}
+}
+
+/**
+ * sessionClose() ends a session, takes it
+ * off the list of sessions and frees it
+ */
+void sessionClose(int poller, struct session **list, struct session *session) {
+	while (*list != session) {
+		list = &(*list)->next;
+	}
+	*list = session->next;
+	epoll_ctl(poller, EPOLL_CTL_DEL, session->fd, 0);
+	close(session->fd);
+	free(session);
+}
+
+/**
+ * serve() runs the event loop of the server: every client
+ * accepted on the given port gets a session of its own, and
+ * all of them are served from one thread through epoll. The
+ * loop wakes every LINK_RETRY_US to repeat the NAKs that
+ * have not been answered
+ */
+int serve(const char *port) {
+	struct epoll_event events[SERVER_EVENTS];
+	struct epoll_event event;
+	struct session *session;
+	struct session *list = 0;
+	struct timespec now;
+	struct timespec retried;
+	unsigned int sessions = 0;
+	int timeout = LINK_RETRY_US / 1000;
+	int listener = hostListen(port, SOMAXCONN);
+	int poller = epoll_create1(0);
+	int count;
+	int i;
+	if (listener < 0 || poller < 0) {
+		return 1;
+	}
+	event.events = EPOLLIN;
+	event.data.ptr = 0;
+	epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event);
+	fprintf(stderr, "serving on port %s, %u bytes per session\n", port,
+			(unsigned int) (sizeof(struct session) + gameContextSize()));
+	clock_gettime(CLOCK_MONOTONIC, &retried);
+	while (1) {
+		count = epoll_wait(poller, events, SERVER_EVENTS, timeout);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec - retried.tv_sec) * 1000000LL +
+				(now.tv_nsec - retried.tv_nsec) / 1000 >= LINK_RETRY_US) {
+			sessionRetry(list);
+			retried = now;
+		}
+		for (i = 0; i < count; i++) {
+			session = events[i].data.ptr;
+			if (session == 0) {
+				session = sessionOpen(listener, ++sessions);
+				if (session != 0) {
+					session->next = list;
+					list = session;
+					event.events = EPOLLIN;
+					event.data.ptr = session;
+					epoll_ctl(poller, EPOLL_CTL_ADD, session->fd, &event);
+					fprintf(stderr, "session %u: connected\n", session->id);
+				}
+				continue;
+			}
+			if (((events[i].events & EPOLLIN) && sessionRead(session) < 0) ||
+					(events[i].events & (EPOLLERR | EPOLLHUP)) || sessionFlush(session) < 0 ||
+					(session->closing && session->txLength == 0)) {
+				fprintf(stderr, "session %u: closed\n", session->id);
+				sessionClose(poller, &list, session);
+				continue;
+			}
+			// Only wait for the socket to drain while output is queued, and
+			// for input while there is room for what it sends
+			event.events = (sessionRoom(session) ? EPOLLIN : 0) | (session->txLength ? EPOLLOUT : 0);
+			event.data.ptr = session;
+			epoll_ctl(poller, EPOLL_CTL_MOD, session->fd, &event);
+		}
+	}
+}
+
+/**
+ * bridge() relays the link bytes of a board wired to the given
+ * serial device to and from the server at host:port unchanged,
+ * so the board plays the server like any other client. The line
+ * speed is left as set up beforehand (e.g. with stty)
+ */
+int bridge(const char *device, char *address) {
+	struct pollfd fds[2];
+	struct termios tty;
+	unsigned char buf[256];
+	char *colon = strrchr(address, ':');
+	int got;
+	int i;
+	if (colon == 0) {
+		fprintf(stderr, "bridge address must be host:port\n");
+		return 1;
+	}
+	*colon = '\0';
+	fds[0].fd = open(device, O_RDWR | O_NOCTTY);
+	if (fds[0].fd < 0) {
+		perror(device);
+		return 1;
+	}
+	if (isatty(fds[0].fd) && tcgetattr(fds[0].fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		tcsetattr(fds[0].fd, TCSANOW, &tty);
+	}
+	fds[1].fd = hostOpenLink(address, colon + 1);
+	if (fds[1].fd < 0) {
+		return 1;
+	}
+	fds[0].events = POLLIN;
+	fds[1].events = POLLIN;
+	while (poll(fds, 2, -1) >= 0) {
+		for (i = 0; i < 2; i++) {
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+				got = read(fds[i].fd, buf, sizeof(buf));
+				if (got <= 0 || write(fds[1 - i].fd, buf, got) != got) {
+					return 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+/**
+ * runServer() parses the command line of a server build:
+ * --serve port, or --bridge device host:port
+ */
+int runServer(int argc, char **argv) {
+	if (hostOptions(&argc, &argv)) {
+		return 1;
+	}
+	srand(getpid());
+	// Session games report to the console; the server logs to stderr
+	freopen("/dev/null", "w", stdout);
+	if (argc == 3 && strcmp(argv[1], "--serve") == 0) {
+		return serve(argv[2]);
+	}
+	if (argc == 4 && strcmp(argv[1], "--bridge") == 0) {
+		return bridge(argv[2], argv[3]);
+	}
+	fprintf(stderr, "usage: %s [--size WxH] [--fec] --serve port | --bridge device host:port\n", argv[0]);
+	return 1;
+}
+#endif
+
+#ifdef HOST_SIM
+/**
+ * replayLog() rebuilds the boards of the first game in an
+ * event log file (written with --log, or a dump of the SRAM
+ * from LOG_BASE on) as they stood after the given number of
+ * shots by either player, or at the end if turn is negative,
+ * and prints them. Nothing is sent or read but the file
+ */
+int replayLog(const char *path, int turn) {
+	struct gameContext *game = 0;
+	unsigned char event[LOG_EVENT_SIZE];
+	unsigned int type;
+	unsigned int flags;
+	unsigned int x;
+	unsigned int y;
+	int turns = 0;
+	int player = 0;
+	int over = -1;
+	FILE *file = fopen(path, "rb");
+	if (file == 0) {
+		perror(path);
+		return 1;
+	}
+	while (fread(event, 1, LOG_EVENT_SIZE, file) == LOG_EVENT_SIZE) {
+		type = event[0] >> 5;
+		flags = event[0] & 0x1F;
+		x = event[1] + 1;
+		y = event[2] + 1;
+		if (type == EVENT_END || (type == EVENT_GAME && game != 0)) {
+			break;
+		}
+		// Only shots count towards the turn limit, so the game and
+		// its placements are always read
+		if ((type == EVENT_SHOT || type == EVENT_INCOMING) && turns == turn) {
+			break;
+		}
+		if (type == EVENT_GAME) {
+			if (setBoardSize(event[1], event[2])) {
+				break;
+			}
+			game = gameContextInit(gameArena, 0);
+			player = flags;
+		} else if (game == 0) {
+			break;
+		} else if (type == EVENT_PLACE && game->shipCount < SHIP_COUNT && !checkIndex(x, y)) {
+			placeShip(game, x, y, flags & ~EVENT_VERTICAL, (flags & EVENT_VERTICAL) != 0);
+		} else if (type == EVENT_SHOT && !checkIndex(x, y)) {
+			writeBoard(game, shotsBase + y - 1, readBoard(game, shotsBase + y - 1) | createByte(x));
+			if (flags & EVENT_HIT) {
+				writeBoard(game, hitsBase + y - 1, readBoard(game, hitsBase + y - 1) | createByte(x));
+			}
+			turns++;
+		} else if (type == EVENT_INCOMING && !checkIndex(x, y)) {
+			writeBoard(game, boardBase + y - 1, readBoard(game, boardBase + y - 1) & ~createByte(x));
+			turns++;
+		} else if (type == EVENT_OVER) {
+			over = flags & EVENT_WON;
+		}
+	}
+	fclose(file);
+	if (game == 0) {
+		fprintf(stderr, "%s: no game in the log\n", path);
+		return 1;
+	}
+	renderMode = RENDER_FULL;
+	conPrintf("Player %x, %ux%u board, after %u shots\n", (unsigned int) player,
+			(unsigned long long) boardWidth, (unsigned long long) boardHeight, (unsigned long long) turns);
+	drawBoards(game);
+	if (over >= 0) {
+		conPrintf(over ? "Player %x won\n" : "Player %x lost\n", (unsigned int) player);
+	}
+	conFlush();
+	return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
+	struct gameContext *game;
+	setBoardSize(boardWidth, boardHeight);
+#ifdef SERVER
+	return runServer(argc, argv);
+#endif
+#ifdef ANALYSIS
+	return runAnalysis(argc, argv);
+#endif
+#ifdef BENCHMARK
+	return runBenchmark(argc, argv);
+#endif
+#ifdef HOST_SIM
+	if (argc >= 3 && strcmp(argv[1], "--replay") == 0) {
+		return replayLog(argv[2], argc > 3 ? atoi(argv[3]) : -1);
+	}
+	if (hostInit(argc, argv)) {
+		return 1;
+	}
+#elif defined(INSTRUMENT)
+	alt_timestamp_start();
+#endif
+	int player;
+	int won;
+	initLink();
+	game = resumeGame();
+	if (game != 0) {
+		// Back from a reset: ask for anything the reset made us miss
+		player = game->player;
+		conPrintf("Resuming the game as player %x\n", player);
+		renderBoards(game);
+		if (!game->yourTurn) {
+			game->awaitingReplay = 1;
+			sendControl(game, FRAME_NAK);
+		}
+	} else {
+		showSplash();
+		game = gameContextInit(gameArena, 1);
+		resetGame(game);
+		setUpBoats(game);
+		syncBoards(game);
+		if (scriptPlay) {
+			player = scriptPlan.player;
+		} else {
+			conPrintf("Are you player 1 or 2? ");
+			player = charToInt(readKey());
+			readKey();
+		}
+	}
+	won = playTurns(game, player);
+	flushLink(game);
+	if (!won) {
+		lingerLink(game);
+	}
+	if (won) {
+		releaseScreen();
+		conPrintf("You sunk all of player %x ships! Game over...", 3 - player);
 	} else {
-		alt_printf("The enemy has sunken all of your ships! Game over...");
+		releaseScreen();
+		conPrintf("The enemy has sunken all of your ships! Game over...");
 	}
+#ifdef INSTRUMENT
+	conPrintf("\n");
+	dumpProbes();
+#endif
+	conFlush();
 
 	return 0;
 }